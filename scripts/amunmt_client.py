@@ -0,0 +1,53 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Send lines from stdin to a running `amun --server-port` and print the
+translations. With -n several clients send the same input concurrently,
+which exercises request coalescing on a local server."""
+
+import sys
+import socket
+import argparse
+import threading
+
+
+def translate(host, port, lines):
+    sock = socket.create_connection((host, port))
+    sock.sendall(("\n".join(lines) + "\n").encode("utf-8"))
+    reader = sock.makefile("rb")
+    output = [reader.readline().decode("utf-8").rstrip("\n") for _ in lines]
+    sock.close()
+    return output
+
+
+def parse_args():
+    """ parse command arguments """
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--host", dest="host", default="127.0.0.1")
+    parser.add_argument("-p", dest="port", default=8080, type=int)
+    parser.add_argument("-n", dest="clients", default=1, type=int,
+                        help="number of concurrent clients")
+    return parser.parse_args()
+
+
+if __name__ == "__main__":
+    args = parse_args()
+    lines = [line.rstrip("\n") for line in sys.stdin]
+
+    results = [None] * args.clients
+
+    def run(i):
+        results[i] = translate(args.host, args.port, lines)
+
+    threads = [threading.Thread(target=run, args=(i,)) for i in range(args.clients)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    for result in results[1:]:
+        if result != results[0]:
+            sys.stderr.write("Clients received different translations\n")
+            sys.exit(1)
+
+    print("\n".join(results[0]))
@@ -0,0 +1,168 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+"""Writes a Nematus model with random weights, matching source and target
+vocabularies and an amun config file, using only the Python standard library.
+
+The model translates nonsense, but has the shapes of a real model of the given
+dimensions, so it can be used to measure speed without downloading anything:
+
+    ./synthetic_model.py -o /tmp/synth --dim-word 512 --dim 1024 \\
+        --src-vocab 85000 --trg-vocab 85000
+    amun -c /tmp/synth/config.yml --benchmark 1000
+"""
+
+import argparse
+import array
+import os
+import random
+import sys
+import zipfile
+
+CONFIG_TEMPLATE = """# Synthetic model, random weights
+relative-paths: yes
+
+beam-size: {beam_size}
+normalize: yes
+cpu-threads: {cpu_threads}
+
+scorers:
+  F0:
+    path: ./model.npz
+    type: Nematus
+
+weights:
+  F0: 1.0
+
+source-vocab: ./vocab.src.yml
+target-vocab: ./vocab.trg.yml
+"""
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-o", "--output-dir", required=True,
+                        help="Directory for model.npz, vocabularies and config.yml")
+    parser.add_argument("--dim-word", type=int, default=500, help="Embedding size")
+    parser.add_argument("--dim", type=int, default=1024, help="Hidden state size")
+    parser.add_argument("--src-vocab", type=int, default=85000, help="Source vocabulary size")
+    parser.add_argument("--trg-vocab", type=int, default=85000, help="Target vocabulary size")
+    parser.add_argument("--beam-size", type=int, default=12)
+    parser.add_argument("--cpu-threads", type=int, default=1)
+    parser.add_argument("--seed", type=int, default=1234)
+    return parser.parse_args()
+
+
+def model_shapes(E, H, VS, VT):
+    """Must list the parameters of bench::ModelParameters in
+    src/bench/synthetic_model.cpp, `amun_bench --check-model` compares them.
+    """
+    shapes = {
+        "Wemb": (VS, E),
+        "Wemb_dec": (VT, E),
+        "ff_state_W": (2 * H, H),
+        "ff_state_b": (H,),
+        "decoder_Wc": (2 * H, 2 * H),
+        "decoder_b_nl": (2 * H,),
+        "decoder_U_nl": (H, 2 * H),
+        "decoder_Wcx": (2 * H, H),
+        "decoder_bx_nl": (H,),
+        "decoder_Ux_nl": (H, H),
+        "decoder_U_att": (2 * H, 1),
+        "decoder_W_comb_att": (H, 2 * H),
+        "decoder_b_att": (2 * H,),
+        "decoder_Wc_att": (2 * H, 2 * H),
+        "decoder_c_tt": (1,),
+        "ff_logit_lstm_W": (H, E),
+        "ff_logit_lstm_b": (E,),
+        "ff_logit_prev_W": (E, E),
+        "ff_logit_prev_b": (E,),
+        "ff_logit_ctx_W": (2 * H, E),
+        "ff_logit_ctx_b": (E,),
+        "ff_logit_W": (E, VT),
+        "ff_logit_b": (VT,),
+    }
+    for prefix in ["encoder_", "encoder_r_", "decoder_"]:
+        shapes.update({
+            prefix + "W": (E, 2 * H),
+            prefix + "b": (2 * H,),
+            prefix + "U": (H, 2 * H),
+            prefix + "Wx": (E, H),
+            prefix + "bx": (H,),
+            prefix + "Ux": (H, H),
+        })
+    return shapes
+
+
+class RandomFloats(object):
+    """Little endian float32 data, uniform in [-scale, scale].
+
+    Drawing every value in Python would take minutes for large models, so
+    chunks of a random pool are copied starting at random offsets.
+    """
+
+    POOL = 1 << 16
+
+    def __init__(self, rng, scale=0.1):
+        self.rng = rng
+        self.pool = array.array("f", (rng.uniform(-scale, scale) for _ in range(self.POOL)))
+        if sys.byteorder == "big":
+            self.pool.byteswap()
+        self.pool = self.pool.tobytes() * 2
+
+    def bytes(self, n):
+        chunks = []
+        while n > 0:
+            count = min(n, self.POOL)
+            start = self.rng.randrange(self.POOL) * 4
+            chunks.append(self.pool[start:start + 4 * count])
+            n -= count
+        return b"".join(chunks)
+
+
+def npy(shape, floats):
+    dims = ", ".join(str(d) for d in shape) + ("," if len(shape) == 1 else "")
+    header = "{'descr': '<f4', 'fortran_order': False, 'shape': (%s), }" % dims
+    # magic, version and header length take 10 bytes, the data is 16 aligned
+    header += " " * (15 - (10 + len(header)) % 16) + "\n"
+    count = 1
+    for d in shape:
+        count *= d
+    return (b"\x93NUMPY\x01\x00" + array.array("H", [len(header)]).tobytes()
+            + header.encode("ascii") + floats.bytes(count))
+
+
+def write_vocab(path, size, prefix):
+    with open(path, "w") as f:
+        f.write('"</s>": 0\n"UNK": 1\n')
+        for i in range(2, size):
+            f.write('"%s%d": %d\n' % (prefix, i, i))
+
+
+def main():
+    args = parse_args()
+    rng = random.Random(args.seed)
+    floats = RandomFloats(rng)
+
+    if not os.path.isdir(args.output_dir):
+        os.makedirs(args.output_dir)
+
+    shapes = model_shapes(args.dim_word, args.dim, args.src_vocab, args.trg_vocab)
+    model = os.path.join(args.output_dir, "model.npz")
+    with zipfile.ZipFile(model, "w", zipfile.ZIP_STORED, allowZip64=True) as z:
+        for name in sorted(shapes):
+            z.writestr(name + ".npy", npy(shapes[name], floats))
+
+    write_vocab(os.path.join(args.output_dir, "vocab.src.yml"), args.src_vocab, "s")
+    write_vocab(os.path.join(args.output_dir, "vocab.trg.yml"), args.trg_vocab, "t")
+
+    with open(os.path.join(args.output_dir, "config.yml"), "w") as f:
+        f.write(CONFIG_TEMPLATE.format(beam_size=args.beam_size,
+                                       cpu_threads=args.cpu_threads))
+
+    sys.stderr.write("Wrote {} and config.yml\n".format(model))
+
+
+if __name__ == "__main__":
+    main()
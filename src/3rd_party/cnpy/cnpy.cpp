@@ -8,6 +8,41 @@
 #include<algorithm>
 #include<cstring>
 #include<iomanip>
+#include<future>
+#include<memory>
+#include<mutex>
+
+namespace {
+
+//closes the file when an npz is left early, e.g. by a failed fread
+struct FileCloser {
+    void operator()(FILE* fp) const { fclose(fp); }
+};
+typedef std::unique_ptr<FILE, FileCloser> FilePtr;
+
+//reader threads taken by npz_load calls that are running at the moment
+std::mutex readers_mutex;
+size_t readers = 0;
+
+//takes up to `wanted` of the `threads` reader threads that all npz_load
+//calls share and gives them back on destruction
+class ReaderBudget {
+    public:
+        ReaderBudget(size_t threads, size_t wanted) : taken_(0) {
+            std::lock_guard<std::mutex> lock(readers_mutex);
+            if(readers < threads) taken_ = std::min(wanted, threads - readers);
+            readers += taken_;
+        }
+        ~ReaderBudget() {
+            std::lock_guard<std::mutex> lock(readers_mutex);
+            readers -= taken_;
+        }
+        size_t taken() const { return taken_; }
+    private:
+        size_t taken_;
+};
+
+}
 
 char cnpy::BigEndianTest() {
     unsigned char x[] = {1,0};
@@ -144,7 +179,8 @@ cnpy::NpyArray load_the_npy_file(FILE* fp) {
 }
 
 cnpy::npz_t cnpy::npz_load(std::string fname) {
-    FILE* fp = fopen(fname.c_str(),"rb");
+    FilePtr file(fopen(fname.c_str(),"rb"));
+    FILE* fp = file.get();
 
     if(!fp) printf("npz_load: Error! Unable to open file %s!\n",fname.c_str());
     assert(fp);
@@ -182,10 +218,151 @@ cnpy::npz_t cnpy::npz_load(std::string fname) {
         arrays[varname] = load_the_npy_file(fp);
     }
 
-    fclose(fp);
     return arrays;  
 }
 
+cnpy::npz_t cnpy::npz_load(std::string fname, size_t threads) {
+    FilePtr file(fopen(fname.c_str(),"rb"));
+    FILE* fp = file.get();
+    if(!fp) throw std::runtime_error("npz_load: unable to open " + fname);
+
+    //first pass over the local headers: name and data offset of every array
+    std::vector<std::pair<std::string, long> > members;
+    bool seekable = true;
+    while(1) {
+        std::vector<char> local_header(30);
+        size_t headerres = fread(&local_header[0],sizeof(char),30,fp);
+        if(headerres != 30)
+            throw std::runtime_error("npz_load: failed fread");
+        if(local_header[2] != 0x03 || local_header[3] != 0x04) break;
+
+        unsigned short flags = *(unsigned short*) &local_header[6];
+        unsigned int size = *(unsigned int*) &local_header[22];
+        //sizes that follow the data or need zip64 extras cannot be skipped
+        if((flags & 0x08) || size == 0xffffffff) {
+            seekable = false;
+            break;
+        }
+
+        unsigned short name_len = *(unsigned short*) &local_header[26];
+        std::string varname(name_len,' ');
+        size_t vname_res = fread(&varname[0],sizeof(char),name_len,fp);
+        if(vname_res != name_len)
+            throw std::runtime_error("npz_load: failed fread");
+        varname.erase(varname.end()-4,varname.end());
+
+        unsigned short extra_field_len = *(unsigned short*) &local_header[28];
+        fseek(fp,extra_field_len,SEEK_CUR);
+        members.push_back(std::make_pair(varname, ftell(fp)));
+        fseek(fp,size,SEEK_CUR);
+    }
+    file.reset();
+
+    if(!seekable || members.size() < 2)
+        return npz_load(fname);
+
+    //archives loaded at the same time share the threads
+    ReaderBudget budget(threads, members.size());
+    if(budget.taken() < 2)
+        return npz_load(fname);
+    threads = budget.taken();
+
+    //every thread reads a share of the arrays through its own file handle
+    std::vector<NpyArray> arrays(members.size());
+    std::vector<std::future<void> > tasks;
+    for(size_t t = 0; t < threads; t++) {
+        tasks.push_back(std::async(std::launch::async, [&, t] {
+            FilePtr member(fopen(fname.c_str(),"rb"));
+            if(!member) throw std::runtime_error("npz_load: unable to open " + fname);
+            for(size_t i = t; i < members.size(); i += threads) {
+                fseek(member.get(),members[i].second,SEEK_SET);
+                arrays[i] = load_the_npy_file(member.get());
+            }
+        }));
+    }
+    for(size_t t = 0; t < threads; t++) tasks[t].get();
+
+    npz_t result;
+    for(size_t i = 0; i < members.size(); i++)
+        result[members[i].first] = arrays[i];
+    return result;
+}
+
+namespace {
+
+template<typename T> T read_le(const char* p) {
+    T value;
+    memcpy(&value,p,sizeof(T));
+    return value;
+}
+
+//parses the header of an npy array at `p`, returns the offset of its data
+size_t parse_npy_buffer(const char* p, size_t size, cnpy::NpyArray& arr) {
+    if(size < 10 || memcmp(p,"\x93NUMPY",6) != 0)
+        throw std::runtime_error("parse_npy_buffer: not an npy array");
+    unsigned char major = p[6];
+    size_t prefix = major == 1 ? 10 : 12;
+    size_t header_len = major == 1 ? read_le<unsigned short>(p+8) : read_le<unsigned int>(p+8);
+    if(prefix + header_len > size)
+        throw std::runtime_error("parse_npy_buffer: truncated header");
+    std::string header(p+prefix,header_len);
+
+    size_t loc1 = header.find("fortran_order")+16;
+    arr.fortran_order = header.substr(loc1,4) == "True";
+
+    loc1 = header.find("(");
+    size_t loc2 = header.find(")");
+    std::string str_shape = header.substr(loc1+1,loc2-loc1-1);
+    arr.shape.clear();
+    std::stringstream dims(str_shape);
+    std::string dim;
+    while(std::getline(dims,dim,','))
+        if(dim.find_first_not_of(' ') != std::string::npos)
+            arr.shape.push_back(atoi(dim.c_str()));
+
+    loc1 = header.find("descr")+9;
+    bool littleEndian = (header[loc1] == '<' || header[loc1] == '|');
+    assert(littleEndian);
+    arr.word_size = atoi(header.substr(loc1+2).c_str());
+    return prefix + header_len;
+}
+
+}
+
+bool cnpy::npz_view(const char* data, size_t size, npz_t& arrays) {
+    size_t pos = 0;
+    while(pos + 30 <= size) {
+        const char* local_header = data + pos;
+        if(local_header[2] != 0x03 || local_header[3] != 0x04) return true;
+
+        unsigned short flags = read_le<unsigned short>(local_header+6);
+        unsigned short compression = read_le<unsigned short>(local_header+8);
+        unsigned int member_size = read_le<unsigned int>(local_header+22);
+        if(compression != 0 || (flags & 0x08) || member_size == 0xffffffff)
+            return false;
+
+        unsigned short name_len = read_le<unsigned short>(local_header+26);
+        unsigned short extra_field_len = read_le<unsigned short>(local_header+28);
+        size_t start = pos + 30 + name_len + extra_field_len;
+        if(start + member_size > size)
+            throw std::runtime_error("npz_view: truncated archive");
+
+        std::string varname(local_header+30,name_len);
+        varname.erase(varname.end()-4,varname.end());
+
+        NpyArray arr;
+        size_t offset = parse_npy_buffer(data+start,member_size,arr);
+        unsigned long long elements = 1;
+        for(size_t i = 0; i < arr.shape.size(); i++) elements *= arr.shape[i];
+        if(offset + elements * arr.word_size > member_size)
+            throw std::runtime_error("npz_view: truncated array " + varname);
+        arr.data = const_cast<char*>(data+start+offset);
+        arrays[varname] = arr;
+        pos = start + member_size;
+    }
+    throw std::runtime_error("npz_view: truncated archive");
+}
+
 cnpy::NpyArray cnpy::npz_load(std::string fname, std::string varname) {
     FILE* fp = fopen(fname.c_str(),"rb");
 
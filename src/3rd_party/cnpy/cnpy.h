@@ -41,6 +41,13 @@ namespace cnpy {
     void parse_npy_header(FILE* fp,unsigned int& word_size, unsigned int*& shape, unsigned int& ndims, bool& fortran_order);
     void parse_zip_footer(FILE* fp, unsigned short& nrecs, unsigned int& global_header_size, unsigned int& global_header_offset);
     npz_t npz_load(std::string fname);
+    //reads the arrays of an uncompressed npz file in parallel. all calls
+    //running at the same time share `threads` reader threads between them
+    npz_t npz_load(std::string fname, size_t threads);
+    //fills `arrays` with views of the arrays of an npz archive in memory,
+    //their data points into `data` and must not be destructed. returns
+    //false if a member is compressed or its size is not in the local header.
+    bool npz_view(const char* data, size_t size, npz_t& arrays);
     NpyArray npz_load(std::string fname, std::string varname);
     NpyArray npy_load(std::string fname);
 
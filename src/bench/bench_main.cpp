@@ -0,0 +1,484 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "common/decoder_options.h"
+#include "common/exception.h"
+#include "common/gemm_profile.h"
+#include "common/logging.h"
+#include "common/god.h"
+#include "common/processor/bpe.h"
+#include "common/vocab.h"
+#include "cpu/decoder/encoder_decoder.h"
+#include "cpu/decoder/best_hyps.h"
+#include "cpu/dl4mt/decoder.h"
+#include "cpu/dl4mt/gru.h"
+#include "cpu/dl4mt/model.h"
+#include "cpu/mblas/matrix.h"
+#include "cpu/mblas/packed_matrix.h"
+#include "cpu/npz_converter.h"
+
+#include "bench/synthetic_model.h"
+
+// Microbenchmarks of the CPU decoder hot paths on randomly initialized
+// weights. Every benchmark runs for every combination of the given sizes
+// and prints one tab separated line with the mean time per call.
+
+namespace po = boost::program_options;
+
+namespace CPU {
+namespace {
+
+struct Sizes {
+  size_t hidden;
+  size_t embedding;
+  size_t vocab;
+  size_t beam;
+  size_t length;
+};
+
+class Runner {
+  public:
+    Runner(double minSeconds, const std::string& filter)
+      : minSeconds_(minSeconds), filter_(filter)
+    {}
+
+    void PrintHeader() {
+      std::cout << "benchmark\thidden\tembedding\tvocab\tbeam\tlength"
+                << "\titerations\tus_per_call" << std::endl;
+    }
+
+    template <class F>
+    void Run(const std::string& name, const Sizes& sizes, F f) {
+      Run(name, sizes, f, []{});
+    }
+
+    // `reset` restores the inputs before every call and is not timed.
+    template <class F, class Reset>
+    void Run(const std::string& name, const Sizes& sizes, F f, Reset reset) {
+      if(!Selected(name))
+        return;
+
+      size_t iterations;
+      double seconds = Measure(f, reset, iterations);
+      std::cout << name << "\t" << sizes.hidden << "\t" << sizes.embedding
+                << "\t" << sizes.vocab << "\t" << sizes.beam << "\t" << sizes.length
+                << "\t" << iterations << "\t" << 1e6 * seconds << std::endl;
+    }
+
+    bool Selected(const std::string& name) const {
+      return name.find(filter_) != std::string::npos;
+    }
+
+    // Mean time in seconds of a call to `f` after a warm-up call.
+    template <class F, class Reset>
+    double Measure(F f, Reset reset, size_t& iterations) {
+      reset();
+      f(); // warm-up
+
+      typedef std::chrono::steady_clock Clock;
+      std::chrono::duration<double> total(0);
+      iterations = 0;
+      while(iterations < 3 || total.count() < minSeconds_) {
+        reset();
+        auto start = Clock::now();
+        f();
+        total += Clock::now() - start;
+        ++iterations;
+      }
+      return total.count() / iterations;
+    }
+
+  private:
+    double minSeconds_;
+    std::string filter_;
+};
+
+mblas::Matrix Random(size_t rows, size_t cols, std::mt19937& rng, float scale = 1.0) {
+  std::uniform_real_distribution<float> dist(-scale, scale);
+  mblas::Matrix m(rows, cols);
+  for(size_t i = 0; i < rows; ++i)
+    for(size_t j = 0; j < cols; ++j)
+      m(i, j) = dist(rng);
+  return m;
+}
+
+// Throws unless the packed kernel computes A * B like blaze does, up to the
+// rounding of a different summation order.
+void VerifyPacked(const mblas::Matrix& A, const mblas::Matrix& B,
+                  const std::string& name) {
+  mblas::Matrix expected = A * B;
+  mblas::Matrix actual;
+  mblas::PackedProd(actual, A, mblas::PackedMatrix(B));
+
+  float worst = 0;
+  for(size_t i = 0; i < expected.rows(); ++i)
+    for(size_t j = 0; j < expected.columns(); ++j)
+      worst = std::max(worst, std::abs(expected(i, j) - actual(i, j))
+                              / (1.0f + std::abs(expected(i, j))));
+  UTIL_THROW_IF2(worst > 1e-4, "Packed product " << name << " " << A.rows()
+                 << "x" << A.columns() << " * " << B.rows() << "x" << B.columns()
+                 << " differs from blaze by " << worst);
+}
+
+// Throws unless the indexed kernel computes A * trans(the rows of Bt at
+// ids) like blaze does.
+void VerifyIndexed(const mblas::Matrix& A, const mblas::Matrix& Bt,
+                   const std::vector<size_t>& ids, const std::string& name) {
+  mblas::Matrix expected = A * blaze::trans(Bt);
+  mblas::Matrix actual;
+  mblas::IndexedProd(actual, A, Bt, ids);
+
+  float worst = 0;
+  for(size_t i = 0; i < actual.rows(); ++i)
+    for(size_t j = 0; j < actual.columns(); ++j) {
+      float e = expected(i, ids.empty() ? j : ids[j]);
+      worst = std::max(worst, std::abs(e - actual(i, j)) / (1.0f + std::abs(e)));
+    }
+  UTIL_THROW_IF2(worst > 1e-4, "Indexed product " << name << " " << A.rows()
+                 << "x" << A.columns() << " * trans(" << Bt.rows() << "x" << Bt.columns()
+                 << ") differs from blaze by " << worst);
+}
+
+std::vector<size_t> RandomIds(size_t n, size_t max, std::mt19937& rng) {
+  std::uniform_int_distribution<size_t> dist(0, max - 1);
+  std::vector<size_t> ids(n);
+  for(auto& id : ids)
+    id = dist(rng);
+  return ids;
+}
+
+void BenchModel(Runner& runner, const Sizes& s) {
+  std::mt19937 rng(42);
+  bench::ModelShape shape = { s.vocab, s.vocab, s.embedding, s.hidden };
+  Weights weights(NpzConverter(bench::SyntheticModel(shape)));
+
+  // GRU
+  {
+    GRU<Weights::GRU> gru(weights.decGru1_);
+    mblas::Matrix state = Random(s.beam, s.hidden, rng);
+    mblas::Matrix context = Random(s.beam, s.embedding, rng);
+    mblas::Matrix next;
+    runner.Run("GRU::GetNextState", s,
+               [&]{ gru.GetNextState(next, state, context); });
+  }
+
+  // Attention
+  {
+    Decoder::Attention<Weights::DecAttention> attention(weights.decAttention_);
+    mblas::Matrix sourceContext = Random(s.length, 2 * s.hidden, rng);
+    mblas::Matrix hidden = Random(s.beam, s.hidden, rng);
+    mblas::Matrix aligned;
+    attention.Init(sourceContext);
+    runner.Run("Attention::GetAlignedSourceContext", s,
+               [&]{ attention.GetAlignedSourceContext(aligned, hidden, sourceContext); });
+  }
+
+  // Output layer
+  {
+    Decoder::Softmax<Weights::DecSoftmax> softmax(weights.decSoftmax_);
+    mblas::Matrix state = Random(s.beam, s.hidden, rng);
+    mblas::Matrix embedding = Random(s.beam, s.embedding, rng);
+    mblas::Matrix aligned = Random(s.beam, 2 * s.hidden, rng);
+    mblas::ArrayMatrix probs;
+    runner.Run("Decoder::Softmax::GetProbs", s,
+               [&]{ softmax.GetProbs(probs, state, embedding, aligned); });
+  }
+
+  // Decoder projections, blaze against the packed kernel
+  {
+    struct Projection {
+      std::string name;
+      size_t k;
+      size_t n;
+    };
+    std::vector<Projection> projections = {
+      { "gru.state", s.hidden, 3 * s.hidden },
+      { "attention.hidden", s.hidden, 2 * s.hidden },
+      { "softmax.output", s.embedding, s.vocab }
+    };
+    for(auto& p : projections) {
+      mblas::Matrix A = Random(s.beam, p.k, rng);
+      mblas::Matrix B = Random(p.k, p.n, rng);
+      mblas::PackedMatrix packed(B);
+      mblas::Matrix C;
+      VerifyPacked(A, B, p.name);
+      runner.Run("Prod blaze " + p.name, s, [&]{ C = A * B; });
+      runner.Run("Prod packed " + p.name, s, [&]{ mblas::PackedProd(C, A, packed); });
+    }
+  }
+
+  // The output layer stored vocab-major, all of it and a shortlist
+  {
+    mblas::Matrix A = Random(s.beam, s.embedding, rng);
+    mblas::Matrix Bt = Random(s.vocab, s.embedding, rng);
+    std::vector<size_t> all;
+    std::vector<size_t> shortlist = RandomIds(s.vocab / 10, s.vocab, rng);
+    mblas::Matrix C;
+    VerifyIndexed(A, Bt, all, "softmax.output");
+    VerifyIndexed(A, Bt, shortlist, "softmax.output_filtered");
+    runner.Run("Prod indexed softmax.output", s,
+               [&]{ mblas::IndexedProd(C, A, Bt, all); });
+    runner.Run("Prod indexed softmax.output_filtered", s,
+               [&]{ mblas::IndexedProd(C, A, Bt, shortlist); });
+  }
+
+  // Softmax normalization alone
+  {
+    mblas::Matrix logits = Random(s.beam, s.vocab, rng);
+    mblas::Matrix probs;
+    runner.Run("mblas::Softmax", s,
+               [&]{ mblas::Softmax(probs); },
+               [&]{ probs = logits; });
+  }
+
+  // Beam search step
+  {
+    // Scorers keep references to their name and config.
+    std::string name = "F0";
+    YAML::Node config;
+    God::GetScorerWeights()[name] = 1.0;
+    std::vector<ScorerPtr> scorers;
+    scorers.emplace_back(new EncoderDecoder(name, config, 0, weights));
+
+    DecoderOptions options;
+    options.beamSize = s.beam;
+    options.normalize = false;
+    options.allowUnk = false;
+    options.nBest = false;
+    options.softmaxFilter = false;
+    options.returnAlignment = false;
+    options.wipo = false;
+    options.binaryOutput = false;
+
+    mblas::Matrix logProbs = Random(s.beam, s.vocab, rng, 10.0);
+    Beam prevHyps;
+    for(size_t i = 0; i < s.beam; ++i)
+      prevHyps.emplace_back(new Hypothesis());
+    Words filterIndices;
+    Beam bestHyps;
+
+    runner.Run("CPU::BestHyps", s,
+               [&]{ BestHyps(bestHyps, prevHyps, s.beam, scorers,
+                              filterIndices, options); },
+               [&]{
+                 static_cast<mblas::ArrayMatrix&>(scorers[0]->GetProbs()) = logProbs;
+                 bestHyps.clear();
+               });
+  }
+
+  // Reordering states along the beam and looking up the embeddings of the
+  // chosen words, as EncoderDecoder::AssembleBeamState does
+  {
+    Decoder::Embeddings<Weights::Embeddings> embeddings(weights.decEmbeddings_);
+    mblas::Matrix states = Random(s.beam, s.hidden, rng);
+    std::vector<size_t> beamIds = RandomIds(s.beam, s.beam, rng);
+    std::vector<size_t> words = RandomIds(s.beam, s.vocab, rng);
+    mblas::Matrix out;
+    mblas::Matrix embedded;
+    runner.Run("AssembleRows beam states", s,
+               [&]{ mblas::AssembleRows(out, states, beamIds); });
+    runner.Run("Embeddings::Lookup", s,
+               [&]{ embeddings.Lookup(embedded, words); });
+  }
+}
+
+// Times every shape of a profile written by amun --gemm-profile as a blaze
+// product of random matrices and with the packed kernel, which is verified
+// against blaze.
+void ReplayGemm(Runner& runner, const std::string& path) {
+  std::cout << "site\tM\tN\tK\tcalls\tus_per_call\tgflops\tprofiled_gflops"
+            << "\tpacked_us_per_call\tpacked_gflops" << std::endl;
+
+  std::mt19937 rng(42);
+  for(auto& shape : GemmProfile::Read(path)) {
+    if(!runner.Selected(shape.site))
+      continue;
+
+    mblas::Matrix A = Random(shape.m, shape.k, rng);
+    mblas::Matrix B = Random(shape.k, shape.n, rng);
+    mblas::Matrix C;
+    size_t iterations;
+    double seconds = runner.Measure([&]{ C = A * B; }, []{}, iterations);
+
+    VerifyPacked(A, B, shape.site);
+    mblas::PackedMatrix packed(B);
+    double packedSeconds = runner.Measure([&]{ mblas::PackedProd(C, A, packed); },
+                                          []{}, iterations);
+
+    double flop = 2e-9 * shape.m * shape.n * shape.k;
+    std::cout << shape.site << "\t" << shape.m << "\t" << shape.n << "\t" << shape.k
+              << "\t" << shape.calls << "\t" << 1e6 * seconds
+              << "\t" << flop / seconds << "\t" << shape.GFlops()
+              << "\t" << 1e6 * packedSeconds << "\t" << flop / packedSeconds
+              << std::endl;
+  }
+}
+
+std::vector<std::string> RandomWords(size_t n, std::mt19937& rng) {
+  std::uniform_int_distribution<int> letter('a', 'z');
+  std::uniform_int_distribution<size_t> length(3, 12);
+  std::vector<std::string> words(n);
+  for(auto& word : words)
+    for(size_t i = length(rng); i > 0; --i)
+      word += (char)letter(rng);
+  return words;
+}
+
+// Merges over the latin alphabet that always join two existing symbols,
+// like a learned code file does.
+void WriteCodes(const std::string& path, size_t merges, std::mt19937& rng) {
+  std::vector<std::string> symbols;
+  for(char c = 'a'; c <= 'z'; ++c)
+    symbols.emplace_back(1, c);
+  symbols.push_back("</w>");
+
+  std::ofstream out(path);
+  for(size_t i = 0; i < merges; ++i) {
+    std::uniform_int_distribution<size_t> pick(0, symbols.size() - 1);
+    std::string left = symbols[pick(rng)];
+    if(left == "</w>") continue;
+    std::string right = symbols[pick(rng)];
+    out << left << " " << right << "\n";
+    symbols.push_back(left + right);
+  }
+}
+
+void BenchText(Runner& runner, const Sizes& s, const boost::filesystem::path& tmp) {
+  std::mt19937 rng(42);
+  std::vector<std::string> words = RandomWords(1000, rng);
+
+  // BPE
+  {
+    std::string codes = (tmp / "codes.txt").string();
+    WriteCodes(codes, s.vocab, rng);
+
+    std::unique_ptr<BPE> bpe;
+    std::string output;
+    auto encodeAll = [&]{
+      output.clear();
+      for(auto& word : words)
+        bpe->Encode(word, output);
+    };
+    runner.Run("BPE::Encode x1000 cold", s, encodeAll,
+               [&]{ bpe.reset(new BPE(codes)); });
+    runner.Run("BPE::Encode x1000 cached", s, encodeAll);
+  }
+
+  // Vocabulary lookup, a tenth of the words are unknown
+  {
+    std::string path = (tmp / "vocab.yml").string();
+    {
+      std::ofstream out(path);
+      std::vector<std::string> known = RandomWords(s.vocab, rng);
+      for(size_t i = 0; i < known.size(); ++i)
+        out << "\"" << known[i] << "\": " << i << "\n";
+      for(size_t i = 0; i < words.size(); ++i)
+        if(i % 10 != 0)
+          words[i] = known[rng() % known.size()];
+    }
+    Vocab vocab(path);
+    // sum the ids so link time optimization cannot drop the lookups
+    volatile size_t sink = 0;
+    runner.Run("Vocab::operator[] x1000", s,
+               [&]{
+                 size_t sum = 0;
+                 for(auto& word : words)
+                   sum += vocab[word];
+                 sink = sum;
+               });
+  }
+}
+
+}
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<size_t> hidden, embedding, vocab, beam, length;
+  double minTime;
+  std::string filter, gemmProfile, checkModel;
+
+  po::options_description options("amun_bench options");
+  options.add_options()
+    ("hidden", po::value(&hidden)->multitoken()->default_value(std::vector<size_t>{ 512 }, "512"),
+     "Hidden state sizes")
+    ("embedding", po::value(&embedding)->multitoken()->default_value(std::vector<size_t>{ 256 }, "256"),
+     "Word embedding sizes")
+    ("vocab", po::value(&vocab)->multitoken()->default_value(std::vector<size_t>{ 30000 }, "30000"),
+     "Vocabulary sizes, also the number of BPE merges")
+    ("beam", po::value(&beam)->multitoken()->default_value(std::vector<size_t>{ 12 }, "12"),
+     "Beam sizes")
+    ("length", po::value(&length)->multitoken()->default_value(std::vector<size_t>{ 30 }, "30"),
+     "Source sentence lengths")
+    ("min-time", po::value(&minTime)->default_value(0.2),
+     "Minimum time in seconds spent on each benchmark")
+    ("filter", po::value(&filter)->default_value(""),
+     "Only run benchmarks whose name contains this string")
+    ("gemm-profile", po::value(&gemmProfile),
+     "Instead of the benchmarks, time every matrix product shape of a "
+     "profile written by amun --gemm-profile")
+    ("check-model", po::value(&checkModel),
+     "Instead of the benchmarks, check that an npz model, e.g. one written by "
+     "scripts/synthetic_model.py, has the parameters of the synthetic models")
+    ("help,h", "Print this help message and exit")
+  ;
+
+  po::variables_map vm;
+  try {
+    po::store(po::parse_command_line(argc, argv, options), vm);
+    po::notify(vm);
+  }
+  catch (std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl << options << std::endl;
+    return EXIT_FAILURE;
+  }
+  if(vm.count("help")) {
+    std::cerr << options << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  // for what the decoder logs, e.g. the kernels chosen for this CPU
+  spdlog::stderr_logger_mt("info")->set_pattern("[%c] (%L) %v");
+
+  if(!checkModel.empty()) {
+    cnpy::npz_t model = cnpy::npz_load(checkModel);
+    bench::ModelShape shape = bench::CheckModel(model);
+    model.destruct();
+    std::cout << checkModel << ": " << shape.sourceVocab << " source words, "
+              << shape.targetVocab << " target words, embedding " << shape.embedding
+              << ", hidden " << shape.hidden << ", parameters match" << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  CPU::Runner runner(minTime, filter);
+  if(!gemmProfile.empty()) {
+    CPU::ReplayGemm(runner, gemmProfile);
+    return EXIT_SUCCESS;
+  }
+
+  auto tmp = boost::filesystem::temp_directory_path()
+             / boost::filesystem::unique_path("amun_bench-%%%%%%%%");
+  boost::filesystem::create_directories(tmp);
+
+  runner.PrintHeader();
+  for(auto v : vocab)
+    CPU::BenchText(runner, CPU::Sizes{ 0, 0, v, 0, 0 }, tmp);
+
+  for(auto h : hidden)
+    for(auto e : embedding)
+      for(auto v : vocab)
+        for(auto b : beam)
+          for(auto l : length)
+            CPU::BenchModel(runner, CPU::Sizes{ h, e, v, b, l });
+
+  boost::filesystem::remove_all(tmp);
+  return EXIT_SUCCESS;
+}
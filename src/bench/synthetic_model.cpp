@@ -0,0 +1,134 @@
+#include "bench/synthetic_model.h"
+
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common/exception.h"
+
+namespace bench {
+
+namespace {
+
+void Add(ParameterShapes& params, const std::string& key,
+         std::vector<unsigned int> shape) {
+  params.emplace_back(key, shape);
+}
+
+void AddGRU(ParameterShapes& params, const std::string& prefix,
+            unsigned int input, unsigned int hidden) {
+  Add(params, prefix + "W", { input, 2 * hidden });
+  Add(params, prefix + "b", { 2 * hidden });
+  Add(params, prefix + "U", { hidden, 2 * hidden });
+  Add(params, prefix + "Wx", { input, hidden });
+  Add(params, prefix + "bx", { hidden });
+  Add(params, prefix + "Ux", { hidden, hidden });
+}
+
+std::string Shape(const std::vector<unsigned int>& shape) {
+  std::stringstream out;
+  out << "(";
+  for(size_t i = 0; i < shape.size(); ++i)
+    out << (i ? ", " : "") << shape[i];
+  out << ")";
+  return out.str();
+}
+
+const std::vector<unsigned int>& Dims(const cnpy::npz_t& model,
+                                      const std::string& key, size_t rank) {
+  auto it = model.find(key);
+  UTIL_THROW_IF2(it == model.end(), "Model has no parameter " << key);
+  UTIL_THROW_IF2(it->second.shape.size() != rank,
+                 "Parameter " << key << " has shape " << Shape(it->second.shape));
+  return it->second.shape;
+}
+
+}
+
+ParameterShapes ModelParameters(const ModelShape& shape) {
+  ParameterShapes params;
+
+  unsigned int E = shape.embedding;
+  unsigned int H = shape.hidden;
+  unsigned int C = 2 * H; // bidirectional source context
+
+  Add(params, "Wemb", { (unsigned int)shape.sourceVocab, E });
+  Add(params, "Wemb_dec", { (unsigned int)shape.targetVocab, E });
+
+  AddGRU(params, "encoder_", E, H);
+  AddGRU(params, "encoder_r_", E, H);
+  AddGRU(params, "decoder_", E, H);
+
+  Add(params, "ff_state_W", { C, H });
+  Add(params, "ff_state_b", { H });
+
+  Add(params, "decoder_Wc", { C, 2 * H });
+  Add(params, "decoder_b_nl", { 2 * H });
+  Add(params, "decoder_U_nl", { H, 2 * H });
+  Add(params, "decoder_Wcx", { C, H });
+  Add(params, "decoder_bx_nl", { H });
+  Add(params, "decoder_Ux_nl", { H, H });
+
+  Add(params, "decoder_U_att", { C, 1 });
+  Add(params, "decoder_W_comb_att", { H, C });
+  Add(params, "decoder_b_att", { C });
+  Add(params, "decoder_Wc_att", { C, C });
+  Add(params, "decoder_c_tt", { 1 });
+
+  Add(params, "ff_logit_lstm_W", { H, E });
+  Add(params, "ff_logit_lstm_b", { E });
+  Add(params, "ff_logit_prev_W", { E, E });
+  Add(params, "ff_logit_prev_b", { E });
+  Add(params, "ff_logit_ctx_W", { C, E });
+  Add(params, "ff_logit_ctx_b", { E });
+  Add(params, "ff_logit_W", { E, (unsigned int)shape.targetVocab });
+  Add(params, "ff_logit_b", { (unsigned int)shape.targetVocab });
+
+  return params;
+}
+
+cnpy::npz_t SyntheticModel(const ModelShape& shape, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> dist(-0.1, 0.1);
+  cnpy::npz_t model;
+
+  for(auto& param : ModelParameters(shape)) {
+    size_t size = 1;
+    for(auto dim : param.second)
+      size *= dim;
+
+    float* data = new float[size];
+    for(size_t i = 0; i < size; ++i)
+      data[i] = dist(rng);
+
+    cnpy::NpyArray& array = model[param.first];
+    array.data = reinterpret_cast<char*>(data);
+    array.shape = param.second;
+    array.word_size = sizeof(float);
+    array.fortran_order = false;
+  }
+  return model;
+}
+
+ModelShape CheckModel(const cnpy::npz_t& model) {
+  ModelShape shape;
+  shape.sourceVocab = Dims(model, "Wemb", 2)[0];
+  shape.embedding = Dims(model, "Wemb", 2)[1];
+  shape.targetVocab = Dims(model, "Wemb_dec", 2)[0];
+  shape.hidden = Dims(model, "ff_state_b", 1)[0];
+
+  ParameterShapes params = ModelParameters(shape);
+  for(auto& param : params) {
+    auto& actual = Dims(model, param.first, param.second.size());
+    UTIL_THROW_IF2(actual != param.second,
+                   "Parameter " << param.first << " has shape " << Shape(actual)
+                   << ", expected " << Shape(param.second));
+  }
+  UTIL_THROW_IF2(model.size() != params.size(),
+                 "Model has " << model.size() << " parameters, expected "
+                 << params.size());
+  return shape;
+}
+
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cnpy/cnpy.h"
+
+namespace bench {
+
+// Dimensions of a Nematus style model.
+struct ModelShape {
+  size_t sourceVocab;
+  size_t targetVocab;
+  size_t embedding;
+  size_t hidden;
+};
+
+// Name and shape of every parameter of a Nematus model, in a fixed order.
+// scripts/synthetic_model.py writes the same parameters, CheckModel()
+// verifies that it does.
+typedef std::vector<std::pair<std::string, std::vector<unsigned int>>> ParameterShapes;
+ParameterShapes ModelParameters(const ModelShape& shape);
+
+// Every parameter of a Nematus model with the given shape, filled with
+// uniform random values from a fixed seed so that runs are reproducible.
+cnpy::npz_t SyntheticModel(const ModelShape& shape, unsigned seed = 1234);
+
+// Throws unless `model` has exactly the parameters ModelParameters() lists
+// for the dimensions of its embeddings and encoder, which it returns.
+ModelShape CheckModel(const cnpy::npz_t& model);
+
+}
@@ -3,9 +3,11 @@
 #include <functional>
 #include <vector>
 
+#include "common/decoder_options.h"
 #include "common/types.h"
 #include "scorer.h"
 
 
 using BestHypsType = std::function<void(Beam&, const Beam&, const size_t,
-                    const std::vector<ScorerPtr>&, const Words&, bool)>;
+                    const std::vector<ScorerPtr>&, const Words&,
+                    const DecoderOptions&)>;
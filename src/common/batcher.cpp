@@ -0,0 +1,90 @@
+#include "common/batcher.h"
+
+#include "common/logging.h"
+#include "common/translation_task.h"
+
+DynamicBatcher::DynamicBatcher(ThreadPool& pool, size_t maxTokens,
+                               std::chrono::microseconds maxWait)
+  : pool_(pool), maxTokens_(maxTokens), maxWait_(maxWait),
+    pendingTokens_(0), batchCounter_(0), stop_(false),
+    dispatcher_([this] { Dispatch(); })
+{}
+
+DynamicBatcher::~DynamicBatcher() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  condition_.notify_all();
+  dispatcher_.join();
+}
+
+std::future<std::string> DynamicBatcher::Add(SentencePtr sentence) {
+  Request request;
+  request.sentence = sentence;
+  request.arrival = Clock::now();
+  std::future<std::string> result = request.promise.get_future();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    pendingTokens_ += sentence->GetWords().size();
+    pending_.push_back(std::move(request));
+  }
+  condition_.notify_one();
+  return result;
+}
+
+void DynamicBatcher::Dispatch() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for(;;) {
+    condition_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+    if(pending_.empty())
+      return;
+
+    auto deadline = pending_.front().arrival + maxWait_;
+    condition_.wait_until(lock, deadline,
+        [this] { return stop_ || pendingTokens_ >= maxTokens_; });
+
+    // Take sentences up to the token budget, the rest starts the next batch.
+    std::shared_ptr<Batch> batch(new Batch());
+    size_t tokens = 0;
+    while(!pending_.empty()) {
+      size_t length = pending_.front().sentence->GetWords().size();
+      if(!batch->empty() && tokens + length > maxTokens_)
+        break;
+      tokens += length;
+      batch->push_back(std::move(pending_.front()));
+      pending_.pop_front();
+    }
+    pendingTokens_ -= tokens;
+
+    lock.unlock();
+    Submit(batch, tokens);
+    lock.lock();
+  }
+}
+
+void DynamicBatcher::Submit(std::shared_ptr<Batch> batch, size_t tokens) {
+  using namespace std::chrono;
+  size_t batchNo = batchCounter_++;
+  Clock::time_point now = Clock::now();
+  double waited = duration_cast<duration<double, std::milli>>(now - batch->front().arrival).count();
+  double fill = std::min(1.0, double(tokens) / maxTokens_);
+
+  LOG(progress) << "Batch " << batchNo << ": " << batch->size() << " sentences, "
+                << tokens << " tokens, fill ratio " << fill
+                << ", waited " << waited << "ms";
+
+  // Search decodes one sentence at a time, so every sentence of the batch
+  // gets its own task and the batch is spread over the decoding threads.
+  for(size_t i = 0; i < batch->size(); ++i) {
+    pool_.enqueue([batch, i] {
+      Request& request = (*batch)[i];
+      try {
+        request.promise.set_value(PrintedTranslationTask(request.sentence));
+      }
+      catch(...) {
+        request.promise.set_exception(std::current_exception());
+      }
+    });
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common/sentence.h"
+#include "common/threadpool.h"
+
+// Collects sentences from concurrent callers into batches and hands the
+// sentences of each batch to the thread pool together, one task per
+// sentence. A batch is closed when its source tokens reach the token budget
+// or when the oldest sentence has waited for maxWait, whichever comes first.
+class DynamicBatcher {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    DynamicBatcher(ThreadPool& pool, size_t maxTokens,
+                   std::chrono::microseconds maxWait);
+    ~DynamicBatcher();
+
+    // Returns the translation as printed by PrintedTranslationTask.
+    std::future<std::string> Add(SentencePtr sentence);
+
+  private:
+    struct Request {
+      SentencePtr sentence;
+      std::promise<std::string> promise;
+      Clock::time_point arrival;
+    };
+    typedef std::vector<Request> Batch;
+
+    void Dispatch();
+    void Submit(std::shared_ptr<Batch> batch, size_t tokens);
+
+    ThreadPool& pool_;
+    const size_t maxTokens_;
+    const std::chrono::microseconds maxWait_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Request> pending_;
+    size_t pendingTokens_;
+    size_t batchCounter_;
+    bool stop_;
+
+    std::thread dispatcher_;
+};
@@ -0,0 +1,93 @@
+#include "common/benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <sstream>
+#include <vector>
+
+#include "common/god.h"
+#include "common/history.h"
+#include "common/printer.h"
+#include "common/synthetic_input.h"
+#include "common/threadpool.h"
+#include "common/translation_task.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Measurement {
+  double seconds;
+  size_t targetTokens;
+};
+
+// Nearest-rank percentile of sorted values.
+double Percentile(const std::vector<double>& sorted, double p) {
+  if(sorted.empty())
+    return 0;
+  size_t rank = std::ceil(p / 100 * sorted.size());
+  return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+}
+
+void RunBenchmark(size_t threads, std::ostream& out) {
+  DecoderOptionsPtr options = God::GetDecoderOptions();
+  SyntheticInput input(God::Get<size_t>("benchmark"),
+                       God::Get<float>("benchmark-length"),
+                       God::Get<float>("benchmark-length-stddev"),
+                       God::Get<size_t>("benchmark-max-length"));
+
+  LOG(info) << "Benchmarking " << God::Get<size_t>("benchmark")
+            << " random sentences on " << threads << " threads";
+
+  std::vector<std::future<Measurement>> results;
+  size_t sourceTokens = 0;
+  Clock::time_point start;
+  {
+    // workers are created and warmed up before the clock starts
+    ThreadPool pool(threads, TranslationWorkerInit());
+    start = Clock::now();
+    SentencePtr sentence;
+    while(input.Pop(sentence)) {
+      sourceTokens += sentence->GetWords().size() - 1;
+      results.push_back(pool.enqueue([=] {
+        auto begin = Clock::now();
+        History history = TranslationTask(sentence, *options);
+        std::stringstream printed;
+        Printer(history, sentence->GetLine(), printed, *options);
+        std::chrono::duration<double> elapsed = Clock::now() - begin;
+
+        const Words& words = history.Top().first;
+        size_t tokens = words.size() - (!words.empty() && words.back() == EOS);
+        return Measurement{ elapsed.count(), tokens };
+      }));
+    }
+  }
+
+  std::vector<double> latencies;
+  size_t targetTokens = 0;
+  for(auto&& result : results) {
+    Measurement m = result.get();
+    latencies.push_back(m.seconds * 1000);
+    targetTokens += m.targetTokens;
+  }
+  std::chrono::duration<double> total = Clock::now() - start;
+  std::sort(latencies.begin(), latencies.end());
+
+  double seconds = total.count();
+  out << "{\"sentences\": " << latencies.size()
+      << ", \"source_tokens\": " << sourceTokens
+      << ", \"target_tokens\": " << targetTokens
+      << ", \"threads\": " << threads
+      << ", \"beam_size\": " << options->beamSize
+      << ", \"seconds\": " << seconds
+      << ", \"sentences_per_second\": " << latencies.size() / seconds
+      << ", \"target_tokens_per_second\": " << targetTokens / seconds
+      << ", \"latency_ms\": {\"p50\": " << Percentile(latencies, 50)
+      << ", \"p90\": " << Percentile(latencies, 90)
+      << ", \"p99\": " << Percentile(latencies, 99)
+      << "}}" << std::endl;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <ostream>
+
+// Decodes `benchmark` random sentences (see SyntheticInput) on `threads`
+// decoder threads and writes throughput and per-sentence latency
+// percentiles to `out` as a JSON object. Translations are produced and
+// formatted like in normal operation, but discarded.
+void RunBenchmark(size_t threads, std::ostream& out);
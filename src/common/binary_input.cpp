@@ -0,0 +1,70 @@
+#include "common/binary_input.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "common/exception.h"
+#include "common/god.h"
+#include "common/vocab.h"
+
+BinaryInput::BinaryInput(std::istream& in)
+  : in_(&in), it_(nullptr), end_(nullptr), lineNo_(0)
+{}
+
+BinaryInput::BinaryInput(const std::string& path)
+  : in_(nullptr),
+    file_(new boost::iostreams::mapped_file_source(path)),
+    it_(file_->data()), end_(file_->data() + file_->size()), lineNo_(0)
+{}
+
+bool BinaryInput::Read(uint32_t* values, size_t count) {
+  size_t bytes = count * sizeof(uint32_t);
+  if(in_)
+    return in_->read(reinterpret_cast<char*>(values), bytes).gcount() == (std::streamsize)bytes;
+
+  if(it_ + bytes > end_)
+    return false;
+  std::memcpy(values, it_, bytes);
+  it_ += bytes;
+  return true;
+}
+
+bool BinaryInput::Pop(SentencePtr& sentence) {
+  uint32_t tabs;
+  if(!Read(&tabs, 1))
+    return false;
+  UTIL_THROW_IF2(tabs == 0, "Sentence " << lineNo_ << " has no tabs");
+  UTIL_THROW_IF2(tabs > God::NumSourceVocabs(),
+                 "Sentence " << lineNo_ << " has " << tabs << " tabs, but there are "
+                 << God::NumSourceVocabs() << " source vocabularies");
+
+  // Counts come from the file, so ids are read in chunks and nothing is
+  // allocated for words that are not there.
+  const size_t CHUNK = 4096;
+  uint32_t ids[CHUNK];
+  std::vector<Words> words(tabs);
+  for(size_t i = 0; i < tabs; ++i) {
+    uint32_t length;
+    UTIL_THROW_IF2(!Read(&length, 1), "Truncated input in sentence " << lineNo_);
+    UTIL_THROW_IF2(!in_ && length > (end_ - it_) / sizeof(uint32_t),
+                   "Truncated input in sentence " << lineNo_);
+
+    size_t vocabSize = God::GetSourceVocab(i).size();
+    words[i].reserve(in_ ? std::min<size_t>(length, CHUNK) + 1 : length + 1);
+    for(size_t done = 0; done < length; ) {
+      size_t count = std::min<size_t>(length - done, CHUNK);
+      UTIL_THROW_IF2(!Read(ids, count), "Truncated input in sentence " << lineNo_);
+      for(size_t j = 0; j < count; ++j) {
+        UTIL_THROW_IF2(ids[j] >= vocabSize,
+                       "Word id " << ids[j] << " out of vocabulary in sentence " << lineNo_);
+        words[i].push_back(ids[j]);
+      }
+      done += count;
+    }
+    words[i].push_back(EOS);
+  }
+
+  sentence.reset(new Sentence(lineNo_++, std::move(words)));
+  return true;
+}
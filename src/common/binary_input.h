@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <memory>
+#include <string>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "common/input.h"
+
+// Reads sentences that are already mapped to source vocabulary ids
+// (input-format: ids). Every sentence is a uint32 number of tabs followed,
+// for each tab, by a uint32 length and that many uint32 word ids, all in
+// native byte order. The end-of-sentence id is appended by the reader.
+// Files are memory-mapped, streams (including gzipped input files) are read
+// sequentially.
+class BinaryInput : public Input {
+  public:
+    BinaryInput(std::istream& in);
+    BinaryInput(const std::string& path);
+
+    bool Pop(SentencePtr& sentence);
+
+  private:
+    bool Read(uint32_t* values, size_t count);
+
+    std::istream* in_;
+    std::unique_ptr<boost::iostreams::mapped_file_source> file_;
+    const char* it_;
+    const char* end_;
+    size_t lineNo_;
+};
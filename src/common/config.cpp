@@ -99,10 +99,21 @@ void Validate(const YAML::Node& config) {
 
   for(auto&& pair: config["scorers"])
     UTIL_THROW_IF2(!(config["weights"][pair.first.as<std::string>()]), "Scorer has no weight: " << pair.first.as<std::string>());
+
+  for(auto key : { "input-format", "output-format" }) {
+    std::string format = config[key].as<std::string>();
+    UTIL_THROW_IF2(format != "text" && format != "ids",
+                   "Unknown " << key << ": " << format);
+    UTIL_THROW_IF2(config["server-port"] && format != "text",
+                   "Server mode only supports text input and output");
+  }
+
+  UTIL_THROW_IF2(config["benchmark"].as<size_t>() > 0 && config["server-port"],
+                 "The benchmark cannot run in server mode");
 }
 
 void OutputRec(const YAML::Node node, YAML::Emitter& out) {
-  std::set<std::string> flow = { "devices" };
+  std::set<std::string> flow = { "devices", "warm-up" };
   std::set<std::string> sorter;
   switch (node.Type()) {
     case YAML::NodeType::Null:
@@ -192,6 +203,86 @@ void Config::AddOptions(size_t argc, char** argv) {
     ("cpu-threads", po::value<size_t>()->default_value(1),
      "Number of threads on the CPU.")
 #endif
+    ("preprocess-threads", po::value<size_t>()->default_value(1),
+     "Number of threads splitting, BPE-encoding and numericizing input "
+     "ahead of the decoders. With 0 input is prepared on the reading thread.")
+    ("server-port", po::value<size_t>(),
+     "Run as a translation server on this TCP port instead of reading input. "
+     "Each line sent by a client is translated and answered in order.")
+    ("server-host", po::value<std::string>()->default_value("127.0.0.1"),
+     "Address the translation server binds to")
+    ("batch-tokens", po::value<size_t>()->default_value(0),
+     "Server mode: group sentences of concurrent clients into batches of up "
+     "to this many source tokens before decoding. This only groups submissions "
+     "to the decoding threads, every sentence is still decoded on its own and "
+     "throughput does not improve. 0 disables batching.")
+    ("batch-max-wait", po::value<size_t>()->default_value(5),
+     "Server mode: maximum time in milliseconds a sentence waits for its "
+     "batch to fill up.")
+    ("cache-size", po::value<size_t>()->default_value(0),
+     "Size in MB of the cache of translated sentences, repeated input is "
+     "answered without decoding. 0 disables the cache.")
+    ("cache-file", po::value<std::string>(),
+     "Keep the translation cache in this file across restarts")
+    ("cache-save-interval", po::value<size_t>()->default_value(300),
+     "Also save the cache file every this many seconds, so that a server "
+     "that is killed keeps its cache. 0 saves at exit only.")
+    ("input-format", po::value<std::string>()->default_value("text"),
+     "Input format: text or ids. ids reads source vocabulary ids as "
+     "length-prefixed uint32 arrays, see README.")
+    ("output-format", po::value<std::string>()->default_value("text"),
+     "Output format: text or ids. ids writes target vocabulary ids and "
+     "scores in binary, see README.")
+    ("benchmark", po::value<size_t>()->default_value(0),
+     "Decode this many random sentences instead of reading input and print "
+     "throughput and latency as JSON. 0 disables the benchmark.")
+    ("benchmark-length", po::value<float>()->default_value(20),
+     "Mean source length of benchmark sentences")
+    ("benchmark-length-stddev", po::value<float>()->default_value(10),
+     "Standard deviation of the source length of benchmark sentences")
+    ("benchmark-max-length", po::value<size_t>()->default_value(80),
+     "Maximum source length of benchmark sentences")
+    ("timing", po::value<bool>()->zero_tokens()->default_value(false),
+     "Measure the time spent in each decoding stage and the search latency "
+     "per source length, written as JSON at exit")
+    ("timing-file", po::value<std::string>(),
+     "Write the timing summary to this file instead of the log")
+    ("timing-interval", po::value<size_t>()->default_value(0),
+     "Also write the timing summary every this many seconds. 0 writes it "
+     "only at exit.")
+    ("trace-file", po::value<std::string>(),
+     "Record decoding activity per thread and write it to this file in "
+     "Chrome trace format (chrome://tracing, Perfetto)")
+    ("trace-buffer", po::value<size_t>()->default_value(100000),
+     "Number of most recent trace events kept per thread")
+    ("trace-sample", po::value<size_t>()->default_value(1),
+     "Trace only every n-th sentence and queued task")
+    ("trace-duration", po::value<size_t>()->default_value(0),
+     "Stop tracing and write the trace after this many seconds. 0 traces "
+     "until exit.")
+    ("metrics-port", po::value<size_t>(),
+     "Serve live metrics (throughput, queue depth, busy time, cache hits, "
+     "latency) in Prometheus format over HTTP on this port")
+    ("metrics-host", po::value<std::string>()->default_value("127.0.0.1"),
+     "Address the metrics endpoint binds to")
+    ("metrics-file", po::value<std::string>(),
+     "Write live metrics in Prometheus format to this file")
+    ("metrics-interval", po::value<size_t>()->default_value(10),
+     "Seconds between updates of metrics-file")
+    ("gemm-profile", po::value<std::string>(),
+     "Record the shape and time of every matrix product of the CPU decoder, "
+     "log a summary at exit and write the profile to this file")
+    ("warm-up", po::value<std::vector<size_t>>()->multitoken()->default_value(std::vector<size_t>(0), ""),
+     "Before taking input, every decoding thread translates a random "
+     "sentence of each of these source lengths, e.g. 5 20 50, to fault in "
+     "weights and size its buffers")
+    ("memory-report", po::value<bool>()->zero_tokens()->default_value(false),
+     "Log the memory held by weights, per-thread scorer buffers, vocabularies, "
+     "filter, BPE tables and caches and live hypotheses after loading, on "
+     "SIGUSR1 and at exit")
+    ("huge-pages", po::value<bool>()->zero_tokens()->default_value(false),
+     "Back the weights of CPU models with 2 MB transparent huge pages "
+     "where the kernel allows it")
     ("show-weights", po::value<bool>()->zero_tokens()->default_value(false),
      "Output used weights to stdout and exit")
     ("load-weights", po::value<std::string>(),
@@ -275,6 +366,36 @@ void Config::AddOptions(size_t argc, char** argv) {
   SET_OPTION("gpu-threads", size_t);
   SET_OPTION("devices", std::vector<size_t>);
 #endif
+  SET_OPTION("preprocess-threads", size_t);
+  SET_OPTION_NONDEFAULT("server-port", size_t);
+  SET_OPTION("server-host", std::string);
+  SET_OPTION("batch-tokens", size_t);
+  SET_OPTION("batch-max-wait", size_t);
+  SET_OPTION("cache-size", size_t);
+  SET_OPTION_NONDEFAULT("cache-file", std::string);
+  SET_OPTION("cache-save-interval", size_t);
+  SET_OPTION_NONDEFAULT("input-file", std::string);
+  SET_OPTION("input-format", std::string);
+  SET_OPTION("output-format", std::string);
+  SET_OPTION("benchmark", size_t);
+  SET_OPTION("benchmark-length", float);
+  SET_OPTION("benchmark-length-stddev", float);
+  SET_OPTION("benchmark-max-length", size_t);
+  SET_OPTION("timing", bool);
+  SET_OPTION_NONDEFAULT("timing-file", std::string);
+  SET_OPTION("timing-interval", size_t);
+  SET_OPTION_NONDEFAULT("trace-file", std::string);
+  SET_OPTION("trace-buffer", size_t);
+  SET_OPTION("trace-sample", size_t);
+  SET_OPTION("trace-duration", size_t);
+  SET_OPTION_NONDEFAULT("metrics-port", size_t);
+  SET_OPTION("metrics-host", std::string);
+  SET_OPTION_NONDEFAULT("metrics-file", std::string);
+  SET_OPTION("metrics-interval", size_t);
+  SET_OPTION_NONDEFAULT("gemm-profile", std::string);
+  SET_OPTION("warm-up", std::vector<size_t>);
+  SET_OPTION("memory-report", bool);
+  SET_OPTION("huge-pages", bool);
   SET_OPTION("show-weights", bool);
   SET_OPTION_NONDEFAULT("load-weights", std::string);
   SET_OPTION("relative-paths", bool);
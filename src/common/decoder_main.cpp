@@ -1,36 +1,32 @@
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <boost/filesystem.hpp>
 #include <boost/timer/timer.hpp>
-#include <boost/thread/tss.hpp>
 
+#include "common/benchmark.h"
+#include "common/binary_input.h"
 #include "common/god.h"
+#include "common/input_pipeline.h"
 #include "common/logging.h"
 #include "common/search.h"
 #include "common/threadpool.h"
-#include "common/printer.h"
 #include "common/sentence.h"
+#include "common/server.h"
+#include "common/translation_task.h"
 #include "common/exception.h"
 
-History TranslationTask(const std::string& in, size_t taskCounter) {
-#ifdef __APPLE__
-  static boost::thread_specific_ptr<Search> s_search;
-  Search *search = s_search.get();
-
-  if(search == NULL) {
-    LOG(info) << "Created Search for thread " << std::this_thread::get_id();
-    search = new Search(taskCounter);
-    s_search.reset(search);
-  }
-#else
-  thread_local std::unique_ptr<Search> search;
-  if(!search) {
-    LOG(info) << "Created Search for thread " << std::this_thread::get_id();
-    search.reset(new Search(taskCounter));
+InputPtr OpenInput(size_t preprocessThreads) {
+  if(God::Get<std::string>("input-format") == "ids") {
+    LOG(info) << "Reading source ids";
+    // compressed files are decompressed by the input stream
+    if(God::Has("input-file")
+       && boost::filesystem::path(God::Get<std::string>("input-file")).extension() != ".gz")
+      return InputPtr(new BinaryInput(God::Get<std::string>("input-file")));
+    return InputPtr(new BinaryInput(God::GetInputStream()));
   }
-#endif
-
-  return search->Decode(Sentence(taskCounter, in));
+  LOG(info) << "Reading input with " << preprocessThreads << " preprocessing threads";
+  return InputPtr(new InputPipeline(God::GetInputStream(), preprocessThreads));
 }
 
 int main(int argc, char* argv[]) {
@@ -39,9 +35,6 @@ int main(int argc, char* argv[]) {
   std::setvbuf(stdin, NULL, _IONBF, 0);
   boost::timer::cpu_timer timer;
 
-  std::string in;
-  std::size_t taskCounter = 0;
-
   size_t cpuThreads = God::Get<size_t>("cpu-threads");
   LOG(info) << "Setting CPU thread count to " << cpuThreads;
 
@@ -56,32 +49,36 @@ int main(int argc, char* argv[]) {
   LOG(info) << "Total number of threads: " << totalThreads;
   UTIL_THROW_IF2(totalThreads == 0, "Total number of threads is 0");
 
-  if (God::Get<bool>("wipo")) {
-    LOG(info) << "Reading input";
-    while (std::getline(God::GetInputStream(), in)) {
-      History result = TranslationTask(in, taskCounter);
-      Printer(result, taskCounter++, std::cout);
+  SentencePtr sentence;
+  if (God::Get<size_t>("benchmark") > 0) {
+    RunBenchmark(totalThreads, std::cout);
+  } else if (God::Has("server-port")) {
+    TranslationServer server(God::Get<std::string>("server-host"),
+                             God::Get<size_t>("server-port"),
+                             totalThreads);
+    server.Run();
+  } else if (God::Get<bool>("wipo")) {
+    InputPtr input = OpenInput(0);
+    while (input->Pop(sentence)) {
+      std::cout << PrintedTranslationTask(sentence);
     }
   } else {
-    ThreadPool pool(totalThreads);
-    LOG(info) << "Reading input";
-
-    std::vector<std::future<History>> results;
+    ThreadPool pool(totalThreads, TranslationWorkerInit());
+    std::vector<std::future<std::string>> results;
 
-    while(std::getline(God::GetInputStream(), in)) {
+    InputPtr input = OpenInput(God::Get<size_t>("preprocess-threads"));
+    while(input->Pop(sentence)) {
+      size_t lineNo = sentence->GetLine();
+      if(lineNo >= results.size())
+        results.resize(lineNo + 1);
 
-      results.emplace_back(
-        pool.enqueue(
-          [=]{ return TranslationTask(in, taskCounter); }
-        )
+      results[lineNo] = pool.enqueue(
+        [=]{ return PrintedTranslationTask(sentence); }
       );
-
-      taskCounter++;
     }
 
-    size_t lineCounter = 0;
     for (auto&& result : results)
-      Printer(result.get(), lineCounter++, std::cout);
+      std::cout << result.get();
   }
   LOG(info) << "Total time: " << timer.format();
   God::CleanUp();
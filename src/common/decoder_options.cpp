@@ -0,0 +1,22 @@
+#include "common/decoder_options.h"
+
+#include <string>
+#include <vector>
+
+#include "common/exception.h"
+#include "common/god.h"
+
+DecoderOptions DecoderOptions::FromConfig() {
+  DecoderOptions options;
+  options.beamSize = God::Get<size_t>("beam-size");
+  options.normalize = God::Get<bool>("normalize");
+  options.allowUnk = God::Get<bool>("allow-unk");
+  options.nBest = God::Get<bool>("n-best");
+  options.softmaxFilter = !God::Get<std::vector<std::string>>("softmax-filter").empty();
+  options.returnAlignment = God::Get<bool>("return-alignment");
+  options.wipo = God::Get<bool>("wipo");
+  options.binaryOutput = God::Get<std::string>("output-format") == "ids";
+
+  UTIL_THROW_IF2(options.beamSize == 0, "beam-size must be at least 1");
+  return options;
+}
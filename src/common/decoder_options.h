@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+// Decoding options read on every sentence or search step, resolved and
+// validated once from the configuration instead of being looked up in the
+// YAML tree each time. God hands out immutable, versioned snapshots: a
+// sentence is decoded and printed with the snapshot taken when it started,
+// so options can be replaced while others are in flight.
+struct DecoderOptions {
+  // Resolves the options from the configuration.
+  static DecoderOptions FromConfig();
+
+  size_t version = 0;
+
+  size_t beamSize;
+  bool normalize;
+  bool allowUnk;
+  bool nBest;
+  bool softmaxFilter;
+  bool returnAlignment;
+  bool wipo;
+  bool binaryOutput;
+};
+
+typedef std::shared_ptr<const DecoderOptions> DecoderOptionsPtr;
@@ -114,6 +114,14 @@ size_t Filter::GetNumFirstWords() const {
   return numFirstWords_;
 }
 
+size_t Filter::GetMemory() const {
+  size_t bytes = mapper_.capacity() * sizeof(Words);
+  for (const auto& translations : mapper_) {
+    bytes += translations.capacity() * sizeof(Word);
+  }
+  return bytes;
+}
+
 void Filter::SetNumFirstWords(const size_t numFirstWords) {
   numFirstWords_ = numFirstWords;
 }
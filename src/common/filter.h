@@ -42,6 +42,9 @@ class Filter {
 
     size_t GetNumFirstWords() const;
 
+    // Bytes held by the translation table.
+    size_t GetMemory() const;
+
     void SetNumFirstWords(size_t numFirstWords);
 
     static std::vector<Words> ParseAlignmentFile(const Vocab& srcVocab,
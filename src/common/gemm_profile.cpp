@@ -0,0 +1,159 @@
+#include "common/gemm_profile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#ifdef __APPLE__
+#include <boost/thread/tss.hpp>
+#endif
+
+#include "common/exception.h"
+#include "common/logging.h"
+#include "common/utils.h"
+
+namespace {
+
+typedef std::tuple<const char*, size_t, size_t, size_t> Key;
+
+struct Stats {
+  uint64_t calls = 0;
+  GemmProfile::Clock::duration elapsed = GemmProfile::Clock::duration::zero();
+};
+
+// Per thread, the mutex is only contended while a report is made.
+struct Shapes {
+  std::mutex mutex;
+  std::map<Key, Stats> stats;
+};
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<Shapes>> registry;
+std::string profilePath;
+
+Shapes* Register() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry.emplace_back(new Shapes());
+  return registry.back().get();
+}
+
+Shapes& Local() {
+#ifdef __APPLE__
+  static boost::thread_specific_ptr<Shapes> local([](Shapes*) {});
+  if(!local.get())
+    local.reset(Register());
+  return *local;
+#else
+  thread_local Shapes* local = Register();
+  return *local;
+#endif
+}
+
+}
+
+bool GemmProfile::enabled_ = false;
+
+void GemmProfile::Add(const char* site, size_t m, size_t n, size_t k,
+                      Clock::duration elapsed) {
+  Shapes& shapes = Local();
+  std::lock_guard<std::mutex> lock(shapes.mutex);
+  Stats& stats = shapes.stats[Key(site, m, n, k)];
+  ++stats.calls;
+  stats.elapsed += elapsed;
+}
+
+void GemmProfile::Start(const std::string& path) {
+  // fail now rather than after the whole run
+  UTIL_THROW_IF2(!std::ofstream(path), "Cannot write matrix product profile to " << path);
+  profilePath = path;
+  enabled_ = true;
+}
+
+void GemmProfile::Stop() {
+  if(!enabled_)
+    return;
+  enabled_ = false;
+
+  std::vector<Shape> shapes = Get();
+  LOG(info) << "Matrix products by total time:";
+  LOG(info) << "site\tM\tN\tK\tcalls\tms\tGFLOP/s";
+  for(auto& shape : shapes) {
+    LOG(info) << shape.site << "\t" << shape.m << "\t" << shape.n << "\t" << shape.k
+              << "\t" << shape.calls << "\t" << shape.seconds * 1000
+              << "\t" << shape.GFlops();
+  }
+
+  Write(profilePath, shapes);
+  LOG(info) << "Wrote " << shapes.size() << " matrix product shapes to " << profilePath;
+}
+
+std::vector<GemmProfile::Shape> GemmProfile::Get() {
+  std::map<std::tuple<std::string, size_t, size_t, size_t>, Stats> merged;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for(auto& shapes : registry) {
+      std::lock_guard<std::mutex> shapesLock(shapes->mutex);
+      for(auto& entry : shapes->stats) {
+        Stats& stats = merged[std::make_tuple(std::string(std::get<0>(entry.first)),
+                                              std::get<1>(entry.first),
+                                              std::get<2>(entry.first),
+                                              std::get<3>(entry.first))];
+        stats.calls += entry.second.calls;
+        stats.elapsed += entry.second.elapsed;
+      }
+    }
+  }
+
+  std::vector<Shape> shapes;
+  for(auto& entry : merged) {
+    shapes.push_back(Shape{ std::get<0>(entry.first), std::get<1>(entry.first),
+                            std::get<2>(entry.first), std::get<3>(entry.first),
+                            entry.second.calls,
+                            std::chrono::duration<double>(entry.second.elapsed).count() });
+  }
+  std::sort(shapes.begin(), shapes.end(), [](const Shape& a, const Shape& b) {
+    return a.seconds > b.seconds;
+  });
+  return shapes;
+}
+
+void GemmProfile::Write(const std::string& path, const std::vector<Shape>& shapes) {
+  std::ofstream out(path);
+  UTIL_THROW_IF2(!out, "Cannot write matrix product profile to " << path);
+  out << "# site\tM\tN\tK\tcalls\tseconds\tgflops\n";
+  for(auto& shape : shapes) {
+    out << shape.site << "\t" << shape.m << "\t" << shape.n << "\t" << shape.k
+        << "\t" << shape.calls << "\t" << shape.seconds << "\t" << shape.GFlops() << "\n";
+  }
+}
+
+std::vector<GemmProfile::Shape> GemmProfile::Read(const std::string& path) {
+  std::ifstream in(path);
+  UTIL_THROW_IF2(!in, "Cannot read matrix product profile " << path);
+
+  std::vector<Shape> shapes;
+  std::string line;
+  size_t lineNo = 0;
+  while(std::getline(in, line)) {
+    ++lineNo;
+    if(line.empty() || line[0] == '#')
+      continue;
+
+    std::vector<std::string> fields;
+    Split(line, fields, "\t");
+    UTIL_THROW_IF2(fields.size() < 6,
+                   "Malformed line " << lineNo << " in " << path);
+    Shape shape;
+    shape.site = fields[0];
+    std::stringstream(fields[1]) >> shape.m;
+    std::stringstream(fields[2]) >> shape.n;
+    std::stringstream(fields[3]) >> shape.k;
+    std::stringstream(fields[4]) >> shape.calls;
+    std::stringstream(fields[5]) >> shape.seconds;
+    shapes.push_back(shape);
+  }
+  return shapes;
+}
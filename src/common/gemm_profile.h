@@ -0,0 +1,49 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shapes and timings of the matrix products issued by the CPU decoder
+// (option gemm-profile). Every distinct call site and (M, N, K) shape of
+// C[MxN] = A[MxK] * B[KxN] is counted with its total time. At exit a table
+// with the achieved GFLOP/s is logged and the profile is written as tab
+// separated text, which amun_bench --gemm-profile replays.
+class GemmProfile {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Shape {
+      std::string site;
+      size_t m;
+      size_t n;
+      size_t k;
+      uint64_t calls;
+      double seconds;
+
+      double GFlops() const {
+        return seconds > 0 ? 2.0 * m * n * k * calls / seconds * 1e-9 : 0;
+      }
+    };
+
+    static bool Enabled() {
+      return enabled_;
+    }
+
+    // `site` must be a string literal.
+    static void Add(const char* site, size_t m, size_t n, size_t k,
+                    Clock::duration elapsed);
+
+    static void Start(const std::string& path);
+    static void Stop();
+
+    // Shapes recorded so far, the most expensive first.
+    static std::vector<Shape> Get();
+
+    static void Write(const std::string& path, const std::vector<Shape>& shapes);
+    static std::vector<Shape> Read(const std::string& path);
+
+  private:
+    static bool enabled_;
+};
@@ -1,3 +1,4 @@
+#include <atomic>
 #include <vector>
 #include <sstream>
 #include <boost/range/adaptor/map.hpp>
@@ -10,7 +11,15 @@
 #include "common/threadpool.h"
 #include "common/file_stream.h"
 #include "common/filter.h"
+#include "common/gemm_profile.h"
+#include "common/huge_pages.h"
+#include "common/memory_report.h"
+#include "common/metrics.h"
 #include "common/processor/bpe.h"
+#include "common/startup_timeline.h"
+#include "common/timing.h"
+#include "common/trace.h"
+#include "common/translation_cache.h"
 #include "common/utils.h"
 
 #include "scorer.h"
@@ -34,71 +43,122 @@ God& God::Init(int argc, char** argv) {
   return Summon().NonStaticInit(argc, argv);
 }
 
-void God::LoadScorers() {
+std::vector<std::shared_future<void>> God::LoadVocabs(StartupTimeline& timeline) {
+  std::vector<std::string> sourcePaths;
+  if(Get("source-vocab").IsSequence())
+    sourcePaths = Get<std::vector<std::string>>("source-vocab");
+  else
+    sourcePaths.push_back(Get<std::string>("source-vocab"));
+  std::string targetPath = Get<std::string>("target-vocab");
+
+  std::vector<std::shared_future<void>> vocabs;
+  sourceVocabs_.resize(sourcePaths.size());
+  for (size_t i = 0; i < sourcePaths.size(); ++i) {
+    std::string path = sourcePaths[i];
+    vocabs.push_back(timeline.Run("source vocabulary " + path, [this, i, path] {
+      sourceVocabs_[i].reset(new Vocab(path));
+    }));
+  }
+  vocabs.push_back(timeline.Run("target vocabulary " + targetPath, [this, targetPath] {
+    targetVocab_.reset(new Vocab(targetPath));
+  }));
+  return vocabs;
+}
+
+void God::LoadScorers(StartupTimeline& timeline,
+                      const std::vector<std::shared_future<void>>& vocabs) {
   LOG(info) << "Loading scorers...";
+  // Loader steps read YAML on their own threads, so every option and scorer
+  // config is read and copied here before the first step starts. YAML nodes
+  // are not safe to share between threads.
+  std::vector<std::pair<std::string, YAML::Node>> scorers;
+  for (auto&& pair : config_.Get()["scorers"])
+    scorers.emplace_back(pair.first.as<std::string>(), YAML::Clone(pair.second));
+  size_t cpuThreads = God::Get<size_t>("cpu-threads");
+
 #ifdef CUDA
+  // GPU loaders read options and vocabularies through God, so they run one
+  // after the other once the vocabularies are there.
+  std::vector<std::shared_future<void>> after = vocabs;
   size_t gpuThreads = God::Get<size_t>("gpu-threads");
   auto devices = God::Get<std::vector<size_t>>("devices");
   if (gpuThreads > 0 && devices.size() > 0) {
-    for (auto&& pair : config_.Get()["scorers"]) {
-      std::string name = pair.first.as<std::string>();
-      gpuLoaders_.emplace(name, LoaderFactory::Create(name, pair.second, "GPU"));
+    for (auto& scorer : scorers) {
+      std::string name = scorer.first;
+      YAML::Node config = YAML::Clone(scorer.second);
+      LoaderPtr& loader = gpuLoaders_[name];
+      after.push_back(timeline.Run("scorer " + name + " (GPU)", [&loader, name, config] {
+        loader = LoaderFactory::Create(name, config, "GPU");
+      }, after));
     }
   }
 #endif
-  size_t cpuThreads = God::Get<size_t>("cpu-threads");
   if (cpuThreads) {
-    for (auto&& pair : config_.Get()["scorers"]) {
-      std::string name = pair.first.as<std::string>();
-      cpuLoaders_.emplace(name, LoaderFactory::Create(name, pair.second, "CPU"));
+    for (auto& scorer : scorers) {
+      std::string name = scorer.first;
+      YAML::Node config = scorer.second;
+      LoaderPtr& loader = cpuLoaders_[name];
+      timeline.Run("scorer " + name, [&loader, name, config] {
+        loader = LoaderFactory::Create(name, config, "CPU");
+      });
     }
   }
 }
 
-void God::LoadFiltering() {
+void God::LoadFiltering(StartupTimeline& timeline,
+                        const std::vector<std::shared_future<void>>& vocabs) {
   if (!Get<std::vector<std::string>>("softmax-filter").empty()) {
     auto filterOptions = Get<std::vector<std::string>>("softmax-filter");
     std::string alignmentFile = filterOptions[0];
     LOG(info) << "Reading target softmax filter file from " << alignmentFile;
-    Filter* filter = nullptr;
-    if (filterOptions.size() >= 3) {
-      const size_t numNFirst = stoi(filterOptions[1]);
-      const size_t maxNumTranslation = stoi(filterOptions[2]);
-      filter = new Filter(GetSourceVocab(0),
-                          GetTargetVocab(),
-                          alignmentFile,
-                          numNFirst,
-                          maxNumTranslation);
-    } else if (filterOptions.size() == 2) {
-      const size_t numNFirst = stoi(filterOptions[1]);
-      filter = new Filter(GetSourceVocab(0),
-                          GetTargetVocab(),
-                          alignmentFile,
-                          numNFirst);
-    } else {
-      filter = new Filter(GetSourceVocab(0),
-                          GetTargetVocab(),
-                          alignmentFile);
-    }
-    filter_.reset(filter);
+    timeline.Run("softmax filter " + alignmentFile, [this, filterOptions, alignmentFile] {
+      Filter* filter = nullptr;
+      if (filterOptions.size() >= 3) {
+        const size_t numNFirst = stoi(filterOptions[1]);
+        const size_t maxNumTranslation = stoi(filterOptions[2]);
+        filter = new Filter(GetSourceVocab(0),
+                            GetTargetVocab(),
+                            alignmentFile,
+                            numNFirst,
+                            maxNumTranslation);
+      } else if (filterOptions.size() == 2) {
+        const size_t numNFirst = stoi(filterOptions[1]);
+        filter = new Filter(GetSourceVocab(0),
+                            GetTargetVocab(),
+                            alignmentFile,
+                            numNFirst);
+      } else {
+        filter = new Filter(GetSourceVocab(0),
+                            GetTargetVocab(),
+                            alignmentFile);
+      }
+      filter_.reset(filter);
+    }, vocabs);
   }
 }
 
-void God::LoadPrePostProcessing() {
+void God::LoadPrePostProcessing(StartupTimeline& timeline) {
   if (Has("bpe")) {
-    if(Get("bpe").IsSequence()) {
-      size_t i = 0;
-      for(auto bpePath : Get<std::vector<std::string>>("bpe")) {
-        LOG(info) << "using bpe: " << bpePath;
-        preprocessors_.push_back(std::vector<PreprocessorPtr>());
-        preprocessors_[i++].emplace_back(new BPE(bpePath));
-      }
+    std::vector<std::string> bpePaths;
+    bool sequence = Get("bpe").IsSequence();
+    if(sequence) {
+      bpePaths = Get<std::vector<std::string>>("bpe");
     }
     else {
-      LOG(info) << "using bpe: " << Get<std::string>("bpe");
-        preprocessors_.push_back(std::vector<PreprocessorPtr>());
-      if (Get<std::string>("bpe") != "") {
-        preprocessors_[0].emplace_back(new BPE(Get<std::string>("bpe")));
+      bpePaths.push_back(Get<std::string>("bpe"));
+    }
+
+    preprocessors_.reserve(bpePaths.size());
+    for(size_t i = 0; i < bpePaths.size(); ++i) {
+      std::string bpePath = bpePaths[i];
+      LOG(info) << "using bpe: " << bpePath;
+      preprocessors_.push_back(std::vector<PreprocessorPtr>());
+      if (sequence || bpePath != "") {
+        preprocessors_[i].emplace_back();
+        PreprocessorPtr& bpe = preprocessors_[i].back();
+        timeline.Run("bpe " + bpePath, [&bpe, bpePath] {
+          bpe.reset(new BPE(bpePath));
+        });
       }
     }
   }
@@ -119,15 +179,6 @@ God& God::NonStaticInit(int argc, char** argv) {
   config_.AddOptions(argc, argv);
   config_.LogOptions();
 
-  if(Get("source-vocab").IsSequence()) {
-    for(auto sourceVocabPath : Get<std::vector<std::string>>("source-vocab"))
-      sourceVocabs_.emplace_back(new Vocab(sourceVocabPath));
-  }
-  else {
-    sourceVocabs_.emplace_back(new Vocab(Get<std::string>("source-vocab")));
-  }
-  targetVocab_.reset(new Vocab(Get<std::string>("target-vocab")));
-
   weights_ = Get<std::map<std::string, float>>("weights");
 
   if(Get<bool>("show-weights")) {
@@ -138,9 +189,6 @@ God& God::NonStaticInit(int argc, char** argv) {
     exit(0);
   }
 
-  LoadScorers();
-  LoadFiltering();
-
   if (Has("input-file")) {
     LOG(info) << "Reading from " << Get<std::string>("input-file");
     inputStream_.reset(new InputFileStream(Get<std::string>("input-file")));
@@ -150,15 +198,87 @@ God& God::NonStaticInit(int argc, char** argv) {
     inputStream_.reset(new InputFileStream(std::cin));
   }
 
-  LoadPrePostProcessing();
+  if (Get<bool>("huge-pages"))
+    HugePages::Enable();
+
+  // Everything that reads options on this thread comes before LoadScorers,
+  // whose GPU steps read them on another one.
+  {
+    StartupTimeline timeline;
+    auto vocabs = LoadVocabs(timeline);
+    LoadPrePostProcessing(timeline);
+    LoadFiltering(timeline, vocabs);
+    LoadScorers(timeline, vocabs);
+    timeline.Wait();
+    timeline.Log();
+  }
+
+  SetDecoderOptions(DecoderOptions::FromConfig());
+  if (Get<bool>("timing")) {
+    LOG(info) << "Timing decoding stages";
+    Timing::Start(Has("timing-file") ? Get<std::string>("timing-file") : "",
+                  Get<size_t>("timing-interval"));
+  }
+
+  if (Has("trace-file")) {
+    LOG(info) << "Tracing to " << Get<std::string>("trace-file");
+    Trace::Start(Get<std::string>("trace-file"), Get<size_t>("trace-buffer"),
+                 Get<size_t>("trace-sample"), Get<size_t>("trace-duration"));
+  }
+
+  size_t cacheSize = Get<size_t>("cache-size");
+  if (cacheSize > 0) {
+    std::string cacheFile = Has("cache-file") ? Get<std::string>("cache-file") : "";
+    LOG(info) << "Caching translations in " << cacheSize << " MB";
+    cache_.reset(new TranslationCache(cacheSize * 1024 * 1024, cacheFile,
+                                      Get<size_t>("cache-save-interval")));
+  }
+
+  if (Has("gemm-profile")) {
+    LOG(info) << "Profiling matrix products";
+    GemmProfile::Start(Get<std::string>("gemm-profile"));
+  }
+
+  if (Has("metrics-port") || Has("metrics-file")) {
+    Metrics::Start(Get<std::string>("metrics-host"),
+                   Has("metrics-port") ? Get<size_t>("metrics-port") : 0,
+                   Has("metrics-file") ? Get<std::string>("metrics-file") : "",
+                   Get<size_t>("metrics-interval"));
+  }
+
+  memory_.Reset([this](MemoryUsage& usage) { GetMemory(usage); });
+  if (Get<bool>("memory-report")) {
+    MemoryReport::Log("after loading");
+    MemoryReport::Start();
+  }
 
   return *this;
 }
 
+void God::GetMemory(MemoryUsage& usage) const {
+  for (auto& vocab : sourceVocabs_)
+    usage["vocab.source"] += vocab->GetMemory();
+  usage["vocab.target"] += targetVocab_->GetMemory();
+
+  if (filter_)
+    usage["filter"] += filter_->GetMemory();
+
+  for (auto& processors : preprocessors_)
+    for (auto& processor : processors)
+      processor->GetMemory(usage);
+
+  if (cache_)
+    usage["translation_cache"] += cache_->GetBytes();
+}
+
 Vocab& God::GetSourceVocab(size_t i) {
   return *(Summon().sourceVocabs_[i]);
 }
 
+size_t God::NumSourceVocabs() {
+  return Summon().sourceVocabs_.size();
+}
+
 Vocab& God::GetTargetVocab() {
   return *Summon().targetVocab_;
 }
@@ -167,6 +287,21 @@ Filter& God::GetFilter() {
   return *(Summon().filter_);
 }
 
+DecoderOptionsPtr God::GetDecoderOptions() {
+  return std::atomic_load(&Summon().decoderOptions_);
+}
+
+void God::SetDecoderOptions(DecoderOptions options) {
+  static std::atomic<size_t> version(0);
+  options.version = version++;
+  std::atomic_store(&Summon().decoderOptions_,
+                    DecoderOptionsPtr(new DecoderOptions(options)));
+}
+
+TranslationCache* God::GetTranslationCache() {
+  return Summon().cache_.get();
+}
+
 std::istream& God::GetInputStream() {
   return *Summon().inputStream_;
 }
@@ -208,25 +343,53 @@ std::map<std::string, float>& God::GetScorerWeights() {
   return Summon().weights_;
 }
 
-std::vector<std::string> God::Preprocess(size_t i, const std::vector<std::string>& input) {
-  std::vector<std::string> processed = input;
-  if (Summon().preprocessors_.size() >= i + 1) {
-    for (const auto& processor : Summon().preprocessors_[i]) {
-      processed = processor->Preprocess(processed);
+namespace {
+
+template <class Processors, class Apply>
+boost::string_view RunProcessors(const Processors& processors, boost::string_view input,
+                                 std::string& buffer, std::string& scratch, Apply apply) {
+  // Stages alternate between the two caller-owned buffers, so both keep
+  // their capacity. The previous output is re-read after the swap since
+  // short strings live inside the object.
+  bool processed = false;
+  for (const auto& processor : processors) {
+    if (processed) {
+      scratch.swap(buffer);
+      input = scratch;
     }
+    buffer.clear();
+    apply(*processor, input, buffer);
+    input = buffer;
+    processed = true;
   }
-  return processed;
+  return input;
 }
 
-std::vector<std::string> God::Postprocess(const std::vector<std::string>& input) {
-  std::vector<std::string> processed = input;
-  for (const auto& processor : Summon().postprocessors_) {
-    processed = processor->Postprocess(processed);
-  }
-  return processed;
 }
+
+boost::string_view God::Preprocess(size_t i, boost::string_view input,
+                                   std::string& buffer, std::string& scratch) {
+  if (Summon().preprocessors_.size() < i + 1)
+    return input;
+  return RunProcessors(Summon().preprocessors_[i], input, buffer, scratch,
+    [](Preprocessor& p, boost::string_view in, std::string& out) { p.Preprocess(in, out); });
+}
+
+boost::string_view God::Postprocess(boost::string_view input,
+                                    std::string& buffer, std::string& scratch) {
+  return RunProcessors(Summon().postprocessors_, input, buffer, scratch,
+    [](Postprocessor& p, boost::string_view in, std::string& out) { p.Postprocess(in, out); });
+}
+
 // clean up cuda vectors before cuda context goes out of scope
 void God::CleanUp() {
+  MemoryReport::Stop();
+  Metrics::Stop();
+  Timing::Stop();
+  Trace::Stop();
+  GemmProfile::Stop();
+  Summon().memory_.Reset();
+  Summon().cache_.reset();
   for (auto& loader : Summon().cpuLoaders_ | boost::adaptors::map_values) {
      loader.reset(nullptr);
   }
@@ -1,10 +1,13 @@
 #pragma once
+#include <future>
 #include <memory>
 #include <iostream>
 
 #include "common/config.h"
+#include "common/decoder_options.h"
 #include "common/loader.h"
 #include "common/logging.h"
+#include "common/memory_report.h"
 #include "common/scorer.h"
 #include "common/types.h"
 #include "common/processor/processor.h"
@@ -14,6 +17,8 @@ class Weights;
 class Vocab;
 class Filter;
 class InputFileStream;
+class TranslationCache;
+class StartupTimeline;
 
 class God {
   public:
@@ -40,20 +45,36 @@ class God {
     }
 
     static Vocab& GetSourceVocab(size_t i = 0);
+    static size_t NumSourceVocabs();
     static Vocab& GetTargetVocab();
 
     static std::istream& GetInputStream();
 
     static Filter& GetFilter();
 
+    // The current decoding options, to be held for the whole sentence.
+    static DecoderOptionsPtr GetDecoderOptions();
+
+    // Replaces the decoding options for sentences started from now on.
+    // The new snapshot gets the next version number.
+    static void SetDecoderOptions(DecoderOptions options);
+
+    // nullptr unless cache-size is set
+    static TranslationCache* GetTranslationCache();
+
     static BestHypsType GetBestHyps(size_t threadId);
 
     static std::vector<ScorerPtr> GetScorers(size_t);
     static std::vector<std::string> GetScorerNames();
     static std::map<std::string, float>& GetScorerWeights();
 
-    static std::vector<std::string> Preprocess(size_t i, const std::vector<std::string>& input);
-    static std::vector<std::string> Postprocess(const std::vector<std::string>& input);
+    // Run the processors over a line of space separated tokens. The result
+    // is either `input` itself or a view of `buffer`. `scratch` holds
+    // intermediate results, `input` may point into it.
+    static boost::string_view Preprocess(size_t i, boost::string_view input,
+                                         std::string& buffer, std::string& scratch);
+    static boost::string_view Postprocess(boost::string_view input,
+                                          std::string& buffer, std::string& scratch);
 
     static void CleanUp();
 
@@ -62,9 +83,14 @@ class God {
   private:
     God& NonStaticInit(int argc, char** argv);
 
-    void LoadScorers();
-    void LoadFiltering();
-    void LoadPrePostProcessing();
+    // Start loading as steps of the timeline, vocabularies first.
+    std::vector<std::shared_future<void>> LoadVocabs(StartupTimeline& timeline);
+    void LoadScorers(StartupTimeline& timeline,
+                     const std::vector<std::shared_future<void>>& vocabs);
+    void LoadFiltering(StartupTimeline& timeline,
+                       const std::vector<std::shared_future<void>>& vocabs);
+    void LoadPrePostProcessing(StartupTimeline& timeline);
+    void GetMemory(MemoryUsage& usage) const;
 
     static God instance_;
     Config config_;
@@ -85,4 +111,11 @@ class God {
     std::shared_ptr<spdlog::logger> progress_;
 
     std::unique_ptr<InputFileStream> inputStream_;
+
+    std::unique_ptr<TranslationCache> cache_;
+
+    // accessed with std::atomic_load/atomic_store
+    DecoderOptionsPtr decoderOptions_;
+
+    MemorySource memory_;
 };
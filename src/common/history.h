@@ -18,8 +18,8 @@ class History {
     };
 
   public:
-    History()
-    :normalize_(God::Get<bool>("normalize"))
+    History(const DecoderOptions& options)
+    :normalize_(options.normalize)
     {}
 
     void Add(const Beam& beam, bool last = false) {
@@ -0,0 +1,103 @@
+#include "common/huge_pages.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "common/logging.h"
+
+#if defined(__linux__) && !defined(MADV_COLLAPSE)
+#define MADV_COLLAPSE 25
+#endif
+
+namespace {
+
+std::atomic<bool> enabled(false);
+// Cleared on the first EINVAL, the kernel predates MADV_COLLAPSE.
+std::atomic<bool> collapse(true);
+
+// The selected mode of e.g. "always [madvise] never".
+std::string SystemMode() {
+  std::ifstream in("/sys/kernel/mm/transparent_hugepage/enabled");
+  std::string line;
+  std::getline(in, line);
+  size_t begin = line.find('[');
+  size_t end = line.find(']', begin);
+  if(begin == std::string::npos || end == std::string::npos)
+    return "";
+  return line.substr(begin + 1, end - begin - 1);
+}
+
+}
+
+void HugePages::Enable() {
+#ifdef __linux__
+  std::string mode = SystemMode();
+  if(mode.empty()) {
+    LOG(info) << "Huge pages: transparent huge pages are not supported, "
+              << "keeping 4 KB pages";
+    return;
+  }
+  if(mode == "never") {
+    LOG(info) << "Huge pages: transparent huge pages are disabled "
+              << "(/sys/kernel/mm/transparent_hugepage/enabled), keeping 4 KB pages";
+    return;
+  }
+  LOG(info) << "Huge pages: backing weights with 2 MB transparent huge pages "
+            << "(system mode " << mode << ")";
+  enabled = true;
+#else
+  LOG(info) << "Huge pages: only supported on Linux, keeping 4 KB pages";
+#endif
+}
+
+bool HugePages::Enabled() {
+  return enabled;
+}
+
+size_t HugePages::Advise(const void* data, size_t bytes) {
+#ifdef __linux__
+  if(!enabled)
+    return 0;
+
+  uintptr_t begin = (reinterpret_cast<uintptr_t>(data) + PageSize - 1) / PageSize * PageSize;
+  uintptr_t end = (reinterpret_cast<uintptr_t>(data) + bytes) / PageSize * PageSize;
+  if(end <= begin)
+    return 0;
+
+  void* start = reinterpret_cast<void*>(begin);
+  size_t length = end - begin;
+  if(madvise(start, length, MADV_HUGEPAGE) != 0)
+    return 0;
+
+  if(collapse && madvise(start, length, MADV_COLLAPSE) != 0) {
+    if(errno == EINVAL && collapse.exchange(false))
+      LOG(info) << "Huge pages: MADV_COLLAPSE is not supported by this kernel, "
+                << "khugepaged collapses advised memory in the background";
+    // Other failures, e.g. EAGAIN when no huge page is free right now, leave
+    // the range advised for khugepaged as well.
+  }
+  return length;
+#else
+  return 0;
+#endif
+}
+
+void HugePages::Log(const std::string& what, size_t advised, size_t bytes) {
+  if(!enabled)
+    return;
+
+  std::stringstream line;
+  line << "Huge pages: " << std::fixed << std::setprecision(2)
+       << advised / 1048576.0 << " of " << bytes / 1048576.0 << " MB of "
+       << what << (collapse ? " in 2 MB pages" : " advised for 2 MB pages");
+  LOG(info) << line.str();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Backs large, long lived buffers such as model weights with 2 MB
+// transparent huge pages (option huge-pages), which saves most of the TLB
+// misses of streaming through hundreds of megabytes of weights per sentence.
+//
+// Buffers are allocated by blaze or std::vector and released with free() or
+// delete, so they cannot come from hugetlbfs. Instead, the part of a buffer
+// that covers whole 2 MB pages is advised with MADV_HUGEPAGE and collapsed
+// right away with MADV_COLLAPSE. Kernels without MADV_COLLAPSE leave the
+// collapse to khugepaged, and where transparent huge pages are disabled,
+// buffers keep their 4 KB pages.
+class HugePages {
+  public:
+    static const size_t PageSize = 2 * 1024 * 1024;
+
+    // Checks what the kernel supports and logs what Advise() will get.
+    static void Enable();
+    static bool Enabled();
+
+    // Returns the bytes of [data, data + bytes) that are now backed by huge
+    // pages, or advised to be, 0 if not enabled or not available.
+    static size_t Advise(const void* data, size_t bytes);
+
+    // Logs how much of the `bytes` of `what` Advise() covered.
+    static void Log(const std::string& what, size_t advised, size_t bytes);
+};
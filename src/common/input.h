@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+
+#include "common/sentence.h"
+
+// Source of sentences for the decoder.
+class Input {
+  public:
+    virtual ~Input() {}
+
+    // Returns false once the input is exhausted. Implementations may return
+    // sentences out of order, GetLine() gives their position in the input.
+    virtual bool Pop(SentencePtr& sentence) = 0;
+};
+
+typedef std::unique_ptr<Input> InputPtr;
@@ -0,0 +1,98 @@
+#include "common/input_pipeline.h"
+
+#include <chrono>
+
+namespace {
+
+// Queues are lock-free, so idle threads spin for a short while before
+// falling back to sleeping.
+void Backoff(size_t& spins) {
+  if(++spins < 64)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+}
+
+}
+
+InputPipeline::InputPipeline(std::istream& in, size_t threads, size_t capacity)
+  : in_(in), capacity_(capacity), lineNo_(0),
+    lines_(capacity), sentences_(capacity),
+    pending_(0), reading_(threads > 0), preparing_(threads)
+{
+  if(threads > 0) {
+    reader_ = std::thread([this] { Read(); });
+    for(size_t i = 0; i < threads; ++i)
+      workers_.emplace_back([this] { Prepare(); });
+  }
+}
+
+InputPipeline::~InputPipeline() {
+  if(reader_.joinable())
+    reader_.join();
+  for(auto& worker : workers_)
+    worker.join();
+
+  RawLine* raw;
+  while(lines_.pop(raw))
+    delete raw;
+  Sentence* sentence;
+  while(sentences_.pop(sentence))
+    delete sentence;
+}
+
+void InputPipeline::Read() {
+  std::string line;
+  while(std::getline(in_, line)) {
+    size_t spins = 0;
+    while(pending_ >= capacity_)
+      Backoff(spins);
+    ++pending_;
+    lines_.push(new RawLine{lineNo_++, line});
+  }
+  reading_ = false;
+}
+
+void InputPipeline::Prepare() {
+  size_t spins = 0;
+  RawLine* raw;
+  for(;;) {
+    if(lines_.pop(raw)) {
+      sentences_.push(new Sentence(raw->lineNo, raw->text));
+      delete raw;
+      spins = 0;
+    }
+    else if(!reading_) {
+      // the reader may have pushed its last line before leaving
+      if(lines_.empty())
+        break;
+    }
+    else {
+      Backoff(spins);
+    }
+  }
+  --preparing_;
+}
+
+bool InputPipeline::Pop(SentencePtr& sentence) {
+  if(workers_.empty()) {
+    std::string line;
+    if(!std::getline(in_, line))
+      return false;
+    sentence.reset(new Sentence(lineNo_++, line));
+    return true;
+  }
+
+  size_t spins = 0;
+  Sentence* prepared;
+  for(;;) {
+    if(sentences_.pop(prepared)) {
+      --pending_;
+      sentence.reset(prepared);
+      return true;
+    }
+    if(preparing_ == 0 && sentences_.empty())
+      return false;
+    Backoff(spins);
+  }
+}
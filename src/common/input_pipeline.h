@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <istream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <boost/lockfree/queue.hpp>
+
+#include "common/input.h"
+#include "common/sentence.h"
+
+// Reads input lines and turns them into Sentence objects (split, BPE,
+// vocabulary lookup) on dedicated threads ahead of the decoders. With zero
+// threads the work is done lazily inside Pop() on the calling thread.
+class InputPipeline : public Input {
+  public:
+    InputPipeline(std::istream& in, size_t threads, size_t capacity = 1024);
+    ~InputPipeline();
+
+    // Blocks until a prepared sentence is available. Sentences can come out
+    // of order when more than one thread is used, use GetLine() to restore
+    // the input order. Returns false once the input is exhausted.
+    bool Pop(SentencePtr& sentence);
+
+  private:
+    struct RawLine {
+      size_t lineNo;
+      std::string text;
+    };
+
+    void Read();
+    void Prepare();
+
+    std::istream& in_;
+    const size_t capacity_;
+    size_t lineNo_;
+
+    boost::lockfree::queue<RawLine*> lines_;
+    boost::lockfree::queue<Sentence*> sentences_;
+
+    std::atomic<size_t> pending_;
+    std::atomic<bool> reading_;
+    std::atomic<size_t> preparing_;
+
+    std::thread reader_;
+    std::vector<std::thread> workers_;
+};
@@ -0,0 +1,122 @@
+#include "common/memory_report.h"
+
+#include <chrono>
+#include <csignal>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "common/logging.h"
+
+namespace {
+
+struct Registry {
+  std::mutex mutex;
+  size_t nextId = 1;
+  std::map<size_t, MemoryReport::Source> sources;
+};
+
+// Never destroyed: static owners such as God may unregister their sources
+// after the static objects of this file are gone.
+Registry& GetRegistry() {
+  static Registry* registry = new Registry();
+  return *registry;
+}
+
+volatile std::sig_atomic_t requested = 0;
+
+void RequestReport(int) {
+  requested = 1;
+}
+
+// Signal handlers can do next to nothing, the watcher polls for requests.
+std::mutex watcherMutex;
+std::condition_variable watcherStop;
+bool stopping = false;
+std::thread watcher;
+
+}
+
+size_t MemoryReport::Register(Source source) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  size_t id = registry.nextId++;
+  registry.sources[id] = std::move(source);
+  return id;
+}
+
+void MemoryReport::Unregister(size_t id) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  registry.sources.erase(id);
+}
+
+MemoryUsage MemoryReport::Get() {
+  MemoryUsage usage;
+  Registry& registry = GetRegistry();
+  // Held while the sources run, so no owner goes away in the meantime.
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for(auto& source : registry.sources)
+    source.second(usage);
+  return usage;
+}
+
+void MemoryReport::Log(const std::string& when) {
+  MemoryUsage usage = Get();
+  size_t total = 0;
+  for(auto& component : usage)
+    total += component.second;
+
+  std::stringstream header;
+  header << "Memory use " << when << ", " << std::fixed << std::setprecision(2)
+         << total / 1048576.0 << " MB in total:";
+  LOG(info) << header.str();
+  for(auto& component : usage) {
+    std::stringstream line;
+    line << std::fixed << std::setprecision(2) << std::setw(10)
+         << component.second / 1048576.0 << " MB  " << component.first;
+    LOG(info) << line.str();
+  }
+}
+
+void MemoryReport::Start() {
+  requested = 0;
+  std::signal(SIGUSR1, RequestReport);
+  LOG(info) << "Send SIGUSR1 to log the memory use";
+
+  stopping = false;
+  watcher = std::thread([] {
+    std::unique_lock<std::mutex> lock(watcherMutex);
+    while(!watcherStop.wait_for(lock, std::chrono::milliseconds(250),
+                                [] { return stopping; })) {
+      if(requested) {
+        requested = 0;
+        Log("on request");
+      }
+    }
+  });
+}
+
+void MemoryReport::Stop() {
+  if(!watcher.joinable())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(watcherMutex);
+    stopping = true;
+  }
+  watcherStop.notify_one();
+  watcher.join();
+  std::signal(SIGUSR1, SIG_DFL);
+  Log("at exit");
+}
+
+void MemoryReport::WritePrometheus(std::ostream& out) {
+  out << "# HELP amun_memory_bytes Host memory held by a component of the decoder.\n"
+      << "# TYPE amun_memory_bytes gauge\n";
+  for(auto& component : Get())
+    out << "amun_memory_bytes{component=\"" << component.first << "\"} "
+        << component.second << "\n";
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+
+// Bytes held per component, e.g. "weights.F0" or "bpe.cache".
+typedef std::map<std::string, size_t> MemoryUsage;
+
+// Host memory held by the large data structures of the decoder, broken down
+// by component (option memory-report). Owners register a source that adds
+// their share to a MemoryUsage whenever a report is made. Sources are called
+// on the reporting thread, so owners that change on another thread report a
+// snapshot taken when it is safe to do so. Device memory of GPU scorers is
+// not accounted for.
+class MemoryReport {
+  public:
+    typedef std::function<void(MemoryUsage&)> Source;
+
+    // Returns an id for Unregister, never 0.
+    static size_t Register(Source source);
+    static void Unregister(size_t id);
+
+    static MemoryUsage Get();
+
+    // Logs the usage per component and in total, `when` says why.
+    static void Log(const std::string& when);
+
+    // Logs a report whenever the process receives SIGUSR1 and at Stop().
+    static void Start();
+    static void Stop();
+
+    static void WritePrometheus(std::ostream& out);
+};
+
+// Registration of a source for the lifetime of its owner, declare it as the
+// last member so the source is gone before the data it reads.
+class MemorySource {
+  public:
+    MemorySource() : id_(0) {}
+
+    explicit MemorySource(MemoryReport::Source source)
+    : id_(MemoryReport::Register(source)) {}
+
+    MemorySource(const MemorySource&) = delete;
+    MemorySource& operator=(const MemorySource&) = delete;
+
+    ~MemorySource() {
+      Reset();
+    }
+
+    void Reset(MemoryReport::Source source) {
+      Reset();
+      id_ = MemoryReport::Register(source);
+    }
+
+    void Reset() {
+      if(id_)
+        MemoryReport::Unregister(id_);
+      id_ = 0;
+    }
+
+  private:
+    size_t id_;
+};
+
+// Heap bytes of a string beyond the object itself.
+inline size_t StringBytes(const std::string& s) {
+  static const size_t local = std::string().capacity();
+  return s.capacity() > local ? s.capacity() + 1 : 0;
+}
+
+// Estimated bytes of a node based hash map without the contents of its
+// elements: one node per element with the next pointer and the cached hash,
+// plus the bucket array.
+template <class Map>
+size_t HashMapBytes(const Map& map) {
+  return map.size() * (sizeof(typename Map::value_type) + 2 * sizeof(void*))
+         + map.bucket_count() * sizeof(void*);
+}
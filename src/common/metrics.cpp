@@ -0,0 +1,365 @@
+#include "common/metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <boost/asio.hpp>
+#ifdef __APPLE__
+#include <boost/thread/tss.hpp>
+#endif
+
+#include "common/exception.h"
+#include "common/god.h"
+#include "common/logging.h"
+#include "common/memory_report.h"
+#include "common/translation_cache.h"
+
+using boost::asio::ip::tcp;
+
+namespace {
+
+// Latency buckets grow by a factor of sqrt(2) from 0.25ms, the last one is
+// open. Quantiles are interpolated within a bucket.
+const size_t LATENCY_BUCKETS = 40;
+const double FIRST_BOUND = 0.00025;
+
+double UpperBound(size_t bucket) {
+  return FIRST_BOUND * std::pow(2.0, bucket / 2.0);
+}
+
+size_t LatencyBucket(double seconds) {
+  if(seconds <= FIRST_BOUND)
+    return 0;
+  size_t bucket = std::ceil(2 * std::log2(seconds / FIRST_BOUND));
+  return std::min(bucket, LATENCY_BUCKETS - 1);
+}
+
+// Written by the owning thread only.
+struct Counters {
+  bool paused = false;
+  Metrics::Clock::time_point registered;
+  std::atomic<uint64_t> sentences;
+  std::atomic<uint64_t> sourceTokens;
+  std::atomic<uint64_t> targetTokens;
+  std::atomic<uint64_t> busyNanos;
+  std::atomic<uint64_t> steps;
+  std::atomic<uint64_t> hypotheses;
+  std::atomic<uint64_t> latency[LATENCY_BUCKETS];
+
+  Counters()
+    : registered(Metrics::Clock::now()),
+      sentences(0), sourceTokens(0), targetTokens(0), busyNanos(0),
+      steps(0), hypotheses(0)
+  {
+    for(auto& count : latency)
+      count = 0;
+  }
+};
+
+inline void Increment(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+std::mutex registryMutex;
+std::vector<std::unique_ptr<Counters>> registry;
+Metrics::Clock::time_point started;
+
+Counters* Register() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry.emplace_back(new Counters());
+  return registry.back().get();
+}
+
+Counters& Local() {
+#ifdef __APPLE__
+  static boost::thread_specific_ptr<Counters> local([](Counters*) {});
+  if(!local.get())
+    local.reset(Register());
+  return *local;
+#else
+  thread_local Counters* local = Register();
+  return *local;
+#endif
+}
+
+double Seconds(Metrics::Clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+void Metric(std::ostream& out, const char* name, const char* type, const char* help) {
+  out << "# HELP " << name << " " << help << "\n"
+      << "# TYPE " << name << " " << type << "\n";
+}
+
+double Quantile(const uint64_t* latency, uint64_t count, double q) {
+  if(count == 0)
+    return 0;
+  double rank = q * count;
+  uint64_t below = 0;
+  for(size_t i = 0; i < LATENCY_BUCKETS; ++i) {
+    if(below + latency[i] >= rank) {
+      double lower = i ? UpperBound(i - 1) : 0;
+      double upper = i < LATENCY_BUCKETS - 1 ? UpperBound(i) : lower;
+      return lower + (upper - lower) * (rank - below) / latency[i];
+    }
+    below += latency[i];
+  }
+  return UpperBound(LATENCY_BUCKETS - 2);
+}
+
+// HTTP endpoint, answers every request with the metrics.
+std::unique_ptr<boost::asio::io_context> io;
+std::unique_ptr<tcp::acceptor> acceptor;
+std::thread endpoint;
+
+// A client has this long to send its request and read the answer, so one
+// that connects and sends nothing does not hold up the endpoint.
+const std::chrono::seconds REQUEST_TIMEOUT(5);
+
+// One request, kept alive by the handlers that refer to it.
+struct Connection : std::enable_shared_from_this<Connection> {
+  tcp::socket socket;
+  boost::asio::steady_timer deadline;
+  boost::asio::streambuf request;
+  std::string response;
+
+  Connection(tcp::socket&& s)
+    : socket(std::move(s)), deadline(socket.get_executor()) {}
+
+  void Start() {
+    auto self = shared_from_this();
+    deadline.expires_after(REQUEST_TIMEOUT);
+    deadline.async_wait([self](const boost::system::error_code& ec) {
+      if(!ec) {
+        boost::system::error_code ignored;
+        self->socket.close(ignored);
+      }
+    });
+    boost::asio::async_read_until(socket, request, "\r\n\r\n",
+        [self](const boost::system::error_code& ec, size_t) {
+          if(ec)
+            return;
+          self->Respond();
+        });
+  }
+
+  void Respond() {
+    std::stringstream body;
+    Metrics::WritePrometheus(body);
+    std::string text = body.str();
+    std::stringstream out;
+    out << "HTTP/1.0 200 OK\r\n"
+        << "Content-Type: text/plain; version=0.0.4\r\n"
+        << "Content-Length: " << text.size() << "\r\n"
+        << "Connection: close\r\n\r\n" << text;
+    response = out.str();
+
+    auto self = shared_from_this();
+    boost::asio::async_write(socket, boost::asio::buffer(response),
+        [self](const boost::system::error_code&, size_t) {
+          self->deadline.cancel();
+          boost::system::error_code ignored;
+          self->socket.close(ignored);
+        });
+  }
+};
+
+void Accept() {
+  acceptor->async_accept([](const boost::system::error_code& ec, tcp::socket socket) {
+    if(ec)
+      return;
+    std::make_shared<Connection>(std::move(socket))->Start();
+    Accept();
+  });
+}
+
+// Periodic metrics file.
+std::mutex writerMutex;
+std::condition_variable writerStop;
+bool stopping = false;
+std::thread writer;
+std::string metricsPath;
+
+void WriteFile() {
+  // written next to the target and renamed, so readers never see half a file
+  std::string tmp = metricsPath + ".tmp";
+  {
+    std::ofstream out(tmp);
+    UTIL_THROW_IF2(!out, "Cannot write metrics to " << tmp);
+    Metrics::WritePrometheus(out);
+  }
+  UTIL_THROW_IF2(std::rename(tmp.c_str(), metricsPath.c_str()) != 0,
+                 "Cannot write metrics to " << metricsPath);
+}
+
+// On the writer thread an exception would end the program.
+void WriteFileOrLog() {
+  try {
+    WriteFile();
+  }
+  catch(std::exception& e) {
+    LOG(info) << "Metrics: " << e.what();
+  }
+}
+
+}
+
+std::atomic<bool> Metrics::enabled_(false);
+std::atomic<int64_t> Metrics::queued_(0);
+
+bool Metrics::Paused() {
+  return Local().paused;
+}
+
+bool Metrics::SetPaused(bool paused) {
+  bool previous = Local().paused;
+  Local().paused = paused;
+  return previous;
+}
+
+void Metrics::AddSentence(size_t sourceTokens, size_t targetTokens,
+                          Clock::duration elapsed) {
+  Counters& counters = Local();
+  Increment(counters.sentences, 1);
+  Increment(counters.sourceTokens, sourceTokens);
+  Increment(counters.targetTokens, targetTokens);
+  Increment(counters.busyNanos,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  Increment(counters.latency[LatencyBucket(Seconds(elapsed))], 1);
+}
+
+void Metrics::AddStep(size_t beamSize) {
+  Counters& counters = Local();
+  Increment(counters.steps, 1);
+  Increment(counters.hypotheses, beamSize);
+}
+
+void Metrics::Start(const std::string& host, size_t port,
+                    const std::string& path, size_t intervalSeconds) {
+  started = Clock::now();
+  enabled_ = true;
+
+  if(port > 0) {
+    io.reset(new boost::asio::io_context());
+    acceptor.reset(new tcp::acceptor(*io, tcp::endpoint(boost::asio::ip::make_address(host), port)));
+    LOG(info) << "Serving metrics on http://" << host << ":" << port << "/metrics";
+    Accept();
+    endpoint = std::thread([] { io->run(); });
+  }
+
+  metricsPath = path;
+  if(!path.empty()) {
+    UTIL_THROW_IF2(intervalSeconds == 0, "metrics-interval must be at least 1");
+    // fail on this thread rather than in the writer
+    WriteFile();
+    stopping = false;
+    writer = std::thread([intervalSeconds] {
+      std::unique_lock<std::mutex> lock(writerMutex);
+      while(!writerStop.wait_for(lock, std::chrono::seconds(intervalSeconds),
+                                 [] { return stopping; }))
+        WriteFileOrLog();
+    });
+  }
+}
+
+void Metrics::Stop() {
+  if(!Enabled())
+    return;
+
+  if(endpoint.joinable()) {
+    io->stop();
+    endpoint.join();
+    acceptor.reset();
+    io.reset();
+  }
+  if(writer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(writerMutex);
+      stopping = true;
+    }
+    writerStop.notify_one();
+    writer.join();
+    WriteFileOrLog();
+  }
+  enabled_ = false;
+}
+
+void Metrics::WritePrometheus(std::ostream& out) {
+  Clock::time_point now = Clock::now();
+  uint64_t sentences = 0, sourceTokens = 0, targetTokens = 0;
+  uint64_t steps = 0, hypotheses = 0;
+  uint64_t latency[LATENCY_BUCKETS] = {};
+  std::vector<std::pair<double, double>> workers;
+  double busySum = 0;
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for(auto& counters : registry) {
+      sentences += counters->sentences.load(std::memory_order_relaxed);
+      sourceTokens += counters->sourceTokens.load(std::memory_order_relaxed);
+      targetTokens += counters->targetTokens.load(std::memory_order_relaxed);
+      steps += counters->steps.load(std::memory_order_relaxed);
+      hypotheses += counters->hypotheses.load(std::memory_order_relaxed);
+      for(size_t i = 0; i < LATENCY_BUCKETS; ++i)
+        latency[i] += counters->latency[i].load(std::memory_order_relaxed);
+
+      double busy = counters->busyNanos.load(std::memory_order_relaxed) * 1e-9;
+      double alive = Seconds(now - counters->registered);
+      workers.emplace_back(busy, std::max(alive - busy, 0.0));
+      busySum += busy;
+    }
+  }
+
+  Metric(out, "amun_uptime_seconds", "gauge", "Time since the metrics were enabled.");
+  out << "amun_uptime_seconds " << Seconds(now - started) << "\n";
+
+  Metric(out, "amun_sentences_total", "counter", "Sentences translated.");
+  out << "amun_sentences_total " << sentences << "\n";
+  Metric(out, "amun_source_tokens_total", "counter", "Source tokens translated, without </s>.");
+  out << "amun_source_tokens_total " << sourceTokens << "\n";
+  Metric(out, "amun_target_tokens_total", "counter", "Target tokens produced, without </s>.");
+  out << "amun_target_tokens_total " << targetTokens << "\n";
+
+  Metric(out, "amun_queue_depth", "gauge", "Tasks waiting for a decoding thread.");
+  out << "amun_queue_depth " << std::max<int64_t>(queued_.load(std::memory_order_relaxed), 0) << "\n";
+
+  // Threads are counted from the first sentence they translated.
+  Metric(out, "amun_worker_busy_seconds_total", "counter", "Time a thread spent translating.");
+  for(size_t i = 0; i < workers.size(); ++i)
+    out << "amun_worker_busy_seconds_total{worker=\"" << i << "\"} " << workers[i].first << "\n";
+  Metric(out, "amun_worker_idle_seconds_total", "counter", "Time a thread did not translate.");
+  for(size_t i = 0; i < workers.size(); ++i)
+    out << "amun_worker_idle_seconds_total{worker=\"" << i << "\"} " << workers[i].second << "\n";
+
+  Metric(out, "amun_decoder_steps_total", "counter", "Decoder steps.");
+  out << "amun_decoder_steps_total " << steps << "\n";
+  Metric(out, "amun_beam_occupancy", "gauge", "Average number of live hypotheses per decoder step.");
+  out << "amun_beam_occupancy " << (steps ? (double)hypotheses / steps : 0) << "\n";
+
+  TranslationCache* cache = God::GetTranslationCache();
+  if(cache) {
+    size_t hits = cache->GetHits(), misses = cache->GetMisses();
+    Metric(out, "amun_cache_hits_total", "counter", "Sentences answered from the translation cache.");
+    out << "amun_cache_hits_total " << hits << "\n";
+    Metric(out, "amun_cache_misses_total", "counter", "Sentences not found in the translation cache.");
+    out << "amun_cache_misses_total " << misses << "\n";
+    Metric(out, "amun_cache_hit_ratio", "gauge", "Share of lookups answered from the translation cache.");
+    out << "amun_cache_hit_ratio " << (hits + misses ? (double)hits / (hits + misses) : 0) << "\n";
+  }
+
+  Metric(out, "amun_sentence_latency_seconds", "summary", "Time to translate a sentence.");
+  for(double q : { 0.5, 0.9, 0.99 })
+    out << "amun_sentence_latency_seconds{quantile=\"" << q << "\"} "
+        << Quantile(latency, sentences, q) << "\n";
+  out << "amun_sentence_latency_seconds_sum " << busySum << "\n"
+      << "amun_sentence_latency_seconds_count " << sentences << "\n";
+
+  MemoryReport::WritePrometheus(out);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Live counters of a long running decoder in the Prometheus text format,
+// served over HTTP on metrics-port and/or written to metrics-file every
+// metrics-interval seconds. Like Timing, every thread updates its own
+// counters without locks or shared cache lines; they are summed up when
+// the metrics are read.
+class Metrics {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    static bool Enabled() {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Whether the calling thread's work is counted: metrics are enabled and
+    // not paused by a MetricsPause on this thread.
+    static bool Active() {
+      return Enabled() && !Paused();
+    }
+
+    // A sentence translated by the calling thread in `elapsed`, which counts
+    // as busy time of that thread.
+    static void AddSentence(size_t sourceTokens, size_t targetTokens,
+                            Clock::duration elapsed);
+
+    // A decoder step with `beamSize` live hypotheses.
+    static void AddStep(size_t beamSize);
+
+    // Tasks waiting in any ThreadPool, kept up to date by the pools.
+    static void TaskQueued() {
+      queued_.fetch_add(1, std::memory_order_relaxed);
+    }
+    static void TaskStarted() {
+      queued_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // Enables the metrics. `port` 0 and an empty `path` disable the
+    // endpoint and the file respectively.
+    static void Start(const std::string& host, size_t port,
+                      const std::string& path, size_t intervalSeconds);
+    static void Stop();
+
+    static void WritePrometheus(std::ostream& out);
+
+  private:
+    friend class MetricsPause;
+
+    static bool Paused();
+    static bool SetPaused(bool paused);
+
+    static std::atomic<bool> enabled_;
+    static std::atomic<int64_t> queued_;
+};
+
+// Leaves the calling thread's work out of the metrics for its lifetime,
+// e.g. warm-up decodes.
+class MetricsPause {
+  public:
+    MetricsPause() : previous_(Metrics::SetPaused(true)) {}
+    ~MetricsPause() { Metrics::SetPaused(previous_); }
+
+  private:
+    bool previous_;
+};
@@ -7,10 +7,62 @@
 #include "common/utils.h"
 #include "common/vocab.h"
 #include "common/soft_alignment.h"
+#include "common/timing.h"
 
+template <class OStream, typename T>
+void WriteBinary(OStream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// output-format: ids. For every sentence a uint32 number of hypotheses (one
+// unless n-best is set), then per hypothesis a uint32 length, that many
+// uint32 target ids without the end-of-sentence id, the float total cost and
+// a uint32 count followed by the float cost of each scorer.
 template <class OStream>
-void Printer(const History& history, size_t lineNo, OStream& out) {
-  std::string best = Join(God::Postprocess(God::GetTargetVocab()(history.Top().first)));
+void BinaryPrinter(const History& history, OStream& out, const DecoderOptions& options) {
+  const NBestList &nbl = history.NBest(options.nBest ? options.beamSize : 1);
+
+  WriteBinary<OStream, uint32_t>(out, nbl.size());
+  for(const Result& result : nbl) {
+    const Words &words = result.first;
+    const HypothesisPtr &hypo = result.second;
+
+    size_t length = words.size();
+    if(length > 0 && words.back() == EOS)
+      --length;
+    WriteBinary<OStream, uint32_t>(out, length);
+    for(size_t i = 0; i < length; ++i)
+      WriteBinary<OStream, uint32_t>(out, words[i]);
+
+    float cost = options.normalize ? hypo->GetCost() / words.size() : hypo->GetCost();
+    WriteBinary<OStream, float>(out, cost);
+    const auto& breakdown = hypo->GetCostBreakdown();
+    WriteBinary<OStream, uint32_t>(out, breakdown.size());
+    for(float scorerCost : breakdown)
+      WriteBinary<OStream, float>(out, scorerCost);
+  }
+}
+
+// Target words as post-processed text, the result lives in one of the
+// buffers.
+inline boost::string_view Detokenize(const Words& words, std::string& buffer,
+                                     std::string& processed) {
+  buffer.clear();
+  God::GetTargetVocab()(words, buffer);
+  return God::Postprocess(buffer, processed, buffer);
+}
+
+template <class OStream>
+void Printer(const History& history, size_t lineNo, OStream& out,
+             const DecoderOptions& options) {
+  ScopedTimer timer(Stage::Print);
+  if(options.binaryOutput) {
+    BinaryPrinter(history, out, options);
+    return;
+  }
+
+  std::string buffer, processed;
+  boost::string_view best = Detokenize(history.Top().first, buffer, processed);
   LOG(progress) << "Best translation: " << best;
 
   // if (God::Get<bool>("return-alignment")) {
@@ -31,10 +83,10 @@ void Printer(const History& history, size_t lineNo, OStream& out) {
     // LOG(progress) << "ALIGN: " << ss.str();
   // }
 
-  if(God::Get<bool>("n-best")) {
+  if(options.nBest) {
     std::vector<std::string> scorerNames = God::GetScorerNames();
-    const NBestList &nbl = history.NBest(God::Get<size_t>("beam-size"));
-    if(God::Get<bool>("wipo")) {
+    const NBestList &nbl = history.NBest(options.beamSize);
+    if(options.wipo) {
       out << "OUT: " << nbl.size() << std::endl;
     }
     for(size_t i = 0; i < nbl.size(); ++i) {
@@ -42,13 +94,13 @@ void Printer(const History& history, size_t lineNo, OStream& out) {
       const Words &words = result.first;
       const HypothesisPtr &hypo = result.second;
 
-      if(God::Get<bool>("wipo"))
+      if(options.wipo)
         out << "OUT: ";
-      out << lineNo << " ||| " << Join(God::Postprocess(God::GetTargetVocab()(words))) << " |||";
+      out << lineNo << " ||| " << Detokenize(words, buffer, processed) << " |||";
       for(size_t j = 0; j < hypo->GetCostBreakdown().size(); ++j) {
         out << " " << scorerNames[j] << "= " << hypo->GetCostBreakdown()[j];
       }
-      if(God::Get<bool>("normalize")) {
+      if(options.normalize) {
         out << " ||| " << hypo->GetCost() / words.size() << std::endl;
       }
       else {
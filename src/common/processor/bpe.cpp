@@ -1,218 +1,232 @@
 #include "common/processor/bpe.h"
 
-#include <mutex>
-#include <sstream>
-#include <iostream>
+#include <queue>
+#include <boost/functional/hash.hpp>
 
 #include "utf8/utf8.h"
 #include "common/utils.h"
 
 
-std::vector<std::string> BPE::Preprocess(const std::vector<std::string> input) {
-  return Encode(input);
+void BPE::Preprocess(boost::string_view input, std::string& output) {
+  bool first = true;
+  ForEachPiece(input, ' ', [&](boost::string_view word) {
+    if (!first) {
+      output += ' ';
+    }
+    Encode(word, output);
+    first = false;
+  });
 }
 
-std::vector<std::string> BPE::Postprocess(const std::vector<std::string> input) {
-  std::vector<std::string> debped;
-  std::stringstream currWord;
-  for (const auto& word : input) {
-    if (EndsWith(word, sep_)) {
-      currWord << word.substr(0, word.size() - sep_.size());
+void BPE::Postprocess(boost::string_view input, std::string& output) {
+  // A word still open at the end of the line is dropped.
+  size_t wordStart = output.size();
+  bool inWord = false;
+  bool first = true;
+  ForEachPiece(input, ' ', [&](boost::string_view token) {
+    if (!inWord) {
+      wordStart = output.size();
+      if (!first) {
+        output += ' ';
+      }
+      inWord = true;
+    }
+    if (token.ends_with(sep_)) {
+      output.append(token.data(), token.size() - sep_.size());
     } else {
-      currWord << word;
-      debped.push_back(currWord.str());
-      currWord.str("");
-      currWord.clear();
+      output.append(token.data(), token.size());
+      inWord = false;
+      first = false;
     }
+  });
+  if (inWord) {
+    output.resize(wordStart);
   }
-  return debped;
+}
+
+void BPE::GetMemory(MemoryUsage& usage) const {
+  size_t merges = HashMapBytes(symbols_) + HashMapBytes(merges_);
+  for (const auto& symbol : symbols_) {
+    merges += StringBytes(symbol.first);
+  }
+  usage["bpe.merges"] += merges;
+
+  size_t cached = 0;
+  for (const auto& shard : cache_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    cached += HashMapBytes(shard.words);
+    for (const auto& word : shard.words) {
+      cached += StringBytes(word.second.word) + StringBytes(word.second.encoded);
+    }
+  }
+  usage["bpe.cache"] += cached;
+}
+
+namespace {
+
+// Upper bound on the number of segmented words kept in the cache.
+const size_t MAX_CACHED_WORDS = 1 << 18;
+
+const std::string END_OF_WORD = "</w>";
+
 }
 
 BPE::BPE()
-  : sep_("@@") {}
+  : sep_("@@"), maxCachedPerShard_(MAX_CACHED_WORDS / CACHE_SHARDS) {}
 
 BPE::BPE(std::ifstream&& file, const std::string sep)
-  : sep_(sep) {
+  : sep_(sep), maxCachedPerShard_(MAX_CACHED_WORDS / CACHE_SHARDS) {
   std::string inputLine;
   size_t index = 0;
   while (std::getline(file, inputLine)) {
     std::vector<std::string> code;
     Split(inputLine, code);
-    bpeCodes_[make_pair(code[0], code[1])] = index++;
+    Symbol left = Intern(code[0]);
+    Symbol right = Intern(code[1]);
+    Symbol merged = Intern(code[0] + code[1]);
+    merges_[(uint64_t)left << 32 | right] = Merge{index++, merged};
   }
 }
 
 BPE::BPE(const std::string& path, const std::string sep)
   : BPE(std::ifstream(path), sep) {}
 
-std::vector<std::string> BPE::Segment(const std::string& sentence) {
-  std::vector<std::string> words, tokens;
-  Split(sentence, words);
-
-  for (auto& word : words) {
-    if (word.empty()) continue;
-    auto codes = Encode(word);
-    for (size_t i = 0; i < codes.size() - 1; ++i) {
-      tokens.emplace_back(codes[i]);
-    }
-    tokens.push_back(codes.back());
-  }
-  return tokens;
+BPE::Symbol BPE::Intern(const std::string& symbol) {
+  return symbols_.emplace(symbol, symbols_.size()).first->second;
 }
 
-void BPE::PrintSegment(const std::string& sentence) {
-  std::vector<std::string> words, tokens;
-  Split(sentence, words);
-
-  for (size_t wi = 0; wi < words.size(); ++wi) {
-    if (words[wi].empty()) continue;
-    auto codes = Encode(words[wi]);
-
-    for (size_t i = 0; i < codes.size() - 1; ++i) {
-      std::cout << codes[i] << " ";
-    }
-    std::cout << codes.back();
-    if (wi == words.size() - 1) {
-      std::cout << std::endl;
-    } else {
-      std::cout << " ";
-    }
-  }
+BPE::Symbol BPE::Lookup(const char* data, size_t length) const {
+  auto it = symbols_.find(std::string(data, length));
+  return it == symbols_.end() ? NO_SYMBOL : it->second;
 }
 
-std::set<BPE::BPEPair> BPE::GetPairs(const std::vector<std::string>& word) {
-  std::set<BPE::BPEPair> pairSet;
-  for (size_t i = 1; i < word.size(); ++i) {
-    pairSet.emplace(word[i-1], word[i]);
+const BPE::Merge* BPE::FindMerge(Symbol left, Symbol right) const {
+  if (left == NO_SYMBOL || right == NO_SYMBOL) {
+    return nullptr;
   }
-  return pairSet;
+  auto it = merges_.find((uint64_t)left << 32 | right);
+  return it == merges_.end() ? nullptr : &it->second;
 }
 
-const BPE::BPEPair* BPE::FindBestBigram(const std::set<BPEPair>& pairs) {
-  size_t minDist = bpeCodes_.size();
-  auto best = bpeCodes_.begin();
-
-  for (const auto& pair : pairs) {
-    auto it = bpeCodes_.find(pair);
-    if (it == bpeCodes_.end()) {
-      continue;
+void BPE::Apply(boost::string_view word, std::string& output) const {
+  // Every symbol is a contiguous byte range of the word followed by the
+  // end-of-word marker, merging two symbols joins their ranges.
+  std::string text(word.data(), word.size());
+  text += END_OF_WORD;
+
+  struct Node {
+    Symbol symbol;
+    size_t begin, end;
+    size_t prev, next;
+  };
+  const size_t NONE = static_cast<size_t>(-1);
+
+  std::vector<Node> nodes;
+  const char* b = text.data();
+  const char* e = text.data() + word.size();
+  while (b != e) {
+    const char* letter = b;
+    utf8::next(b, e);
+    size_t begin = letter - text.data();
+    size_t end = b - text.data();
+    nodes.push_back({Lookup(letter, end - begin), begin, end,
+                     nodes.size() - 1, nodes.size() + 1});
+  }
+  nodes.push_back({Lookup(END_OF_WORD.data(), END_OF_WORD.size()),
+                   word.size(), text.size(), nodes.size() - 1, NONE});
+  nodes.front().prev = NONE;
+
+  // Candidate merges ordered by rank, then by position. Entries go stale when
+  // one of their nodes has been merged in the meantime and are skipped.
+  struct Candidate {
+    size_t rank;
+    size_t left;
+    Symbol leftSymbol, rightSymbol, merged;
+    bool operator<(const Candidate& other) const {
+      return rank > other.rank || (rank == other.rank && left > other.left);
     }
-    if (it->second < minDist) {
-      minDist = it->second;
-      best = it;
+  };
+  std::priority_queue<Candidate> queue;
+  auto push = [&](size_t left) {
+    if (left == NONE || nodes[left].next == NONE) return;
+    const Node& l = nodes[left];
+    const Node& r = nodes[l.next];
+    if (const Merge* merge = FindMerge(l.symbol, r.symbol)) {
+      queue.push({merge->rank, left, l.symbol, r.symbol, merge->merged});
     }
+  };
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    push(i);
   }
-  if (minDist == bpeCodes_.size()) {
-    return nullptr;
-  }
-  else {
-  return &(best->first);
-  }
-}
 
-std::vector<std::string>& BPE::Encode(const std::string& word) {
-  if (IsCached(word)) {
-    return cache_[word];
-  }
-
-  std::vector<std::string> vWord = SplitWordIntoLetters(word);
-  vWord.push_back("</w>");
+  while (!queue.empty()) {
+    Candidate top = queue.top();
+    queue.pop();
 
-  auto pairs = GetPairs(vWord);
+    Node& left = nodes[top.left];
+    if (left.symbol != top.leftSymbol || left.next == NONE) continue;
+    Node& right = nodes[left.next];
+    if (right.symbol != top.rightSymbol) continue;
 
-  while (true) {
-    const BPEPair* bigram = FindBestBigram(pairs);
-    if (bigram == nullptr) {
-      break;
+    left.symbol = top.merged;
+    left.end = right.end;
+    left.next = right.next;
+    if (right.next != NONE) {
+      nodes[right.next].prev = top.left;
     }
+    right.symbol = NO_SYMBOL;
 
-    std::vector<std::string> newWord;
-
-    auto it = vWord.begin();
-    while (it != vWord.end()) {
-      auto jt = std::find(it, vWord.end(), bigram->first);
-      for (auto i = it; i != jt; ++i) {
-        newWord.push_back(*i);
-      }
-
-      if (jt == vWord.end()) {
-        break;
-      }
-      it = jt;
-
-      if (*it == bigram->first && (it+1) != vWord.end() && *(it+1) == bigram->second) {
-        newWord.emplace_back(bigram->first + bigram->second);
-        it += 2;
-      } else {
-        newWord.push_back(*it);
-        it += 1;
-      }
-    }
-    std::swap(vWord, newWord);
-    if (newWord.size() == 1) {
-      break;
-    } else {
-      pairs = GetPairs(vWord);
-    }
+    push(left.prev);
+    push(top.left);
   }
 
-  if (vWord.back() == "</w>") {
-    vWord.pop_back();
+  std::vector<boost::string_view> segmented;
+  for (size_t i = 0; i != NONE; i = nodes[i].next) {
+    segmented.emplace_back(text.data() + nodes[i].begin, nodes[i].end - nodes[i].begin);
   }
 
-  if (EndsWith(vWord.back(), "</w>")) {
-    vWord.back().resize(vWord.back().size() - 4);
+  if (segmented.back() == END_OF_WORD) {
+    segmented.pop_back();
   }
-
-  for (size_t i = 0;  i < vWord.size() - 1; ++i) {
-    vWord[i] = vWord[i] + sep_;
+  if (segmented.empty()) {
+    return;
   }
 
-  std::mutex mtx;
-  mtx.lock();
-  cache_[word] = vWord;
-  mtx.unlock();
-
-  return cache_[word];
-}
+  if (segmented.back().ends_with(END_OF_WORD)) {
+    segmented.back().remove_suffix(END_OF_WORD.size());
+  }
 
-std::vector<std::string> BPE::Encode(const std::vector<std::string>& words) {
-  std::vector<std::string> result;
-  for (const auto& word : words) {
-    auto& encoded = Encode(word);
-    result.insert(result.end(), encoded.begin(), encoded.end());
+  for (size_t i = 0;  i < segmented.size(); ++i) {
+    output.append(segmented[i].data(), segmented[i].size());
+    if (i + 1 < segmented.size()) {
+      output += sep_;
+      output += ' ';
+    }
   }
-  // std::cerr << "BPE: ";
-  // for (auto& code: result) std::cerr << code << " " ;
-  // std::cerr << std::endl;
-  return result;
 }
 
+void BPE::Encode(boost::string_view word, std::string& output) {
+  size_t hash = boost::hash_range(word.begin(), word.end());
+  CacheShard& shard = cache_[hash % CACHE_SHARDS];
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.words.find(hash);
+    if (it != shard.words.end() && it->second.word == word) {
+      output += it->second.encoded;
+      return;
+    }
+  }
 
-bool BPE::IsCached(const std::string& word) const {
-  return cache_.find(word) != cache_.end();
-}
-
-std::vector<std::string> BPE::SplitWordIntoLetters(const std::string& word) const {
-  char* charWord = (char*)word.c_str();
-  auto b = charWord;
-  auto e = charWord + strlen(charWord);
+  CachedWord cached;
+  cached.word.assign(word.data(), word.size());
+  Apply(word, cached.encoded);
+  output += cached.encoded;
 
-  std::vector<std::string> letters;
-  int prevBegin = 0;
-  while (b != e) {
-    int end = utf8::next(b, e);
-    std::vector<unsigned char> utf8result;
-    utf8::utf32to8(&end,&end + 1, std::back_inserter(utf8result));
-    letters.emplace_back(utf8result.begin(), utf8result.end());
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (shard.words.size() >= maxCachedPerShard_) {
+    // cheaper than tracking recency, frequent words come back quickly
+    shard.words.clear();
   }
-  return letters;
+  shard.words[hash] = std::move(cached);
 }
 
-bool BPE::EndsWith(std::string const &fullString, std::string const suffix) const {
-  if (fullString.length() >= suffix.length()) {
-    return (0 == fullString.compare(fullString.length() - suffix.length(), suffix.length(), suffix));
-  } else {
-    return false;
-  }
-}
@@ -1,70 +1,68 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <fstream>
-#include <set>
+#include <mutex>
 #include <unordered_map>
-#include <iterator>
 
 #include "common/processor/processor.h"
 
-template<class T>
-inline void hash_combine(std::size_t & seed, const T & v)
-{
-  std::hash<T> hasher;
-  seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
-}
-
-namespace std
-{
-  template<typename S, typename T> struct hash<pair<S, T>>
-  {
-      inline size_t operator()(const pair<S, T> & v) const
-      {
-            size_t seed = 0;
-            ::hash_combine(seed, v.first);
-            ::hash_combine(seed, v.second);
-            return seed;
-          }
-    };
-}
-
+// Byte pair encoding of input words, safe to call from any number of threads.
+// Symbols in the merge table are interned to integer ids at load time, a word
+// is segmented by repeatedly applying the lowest ranked merge taken from a
+// priority queue over adjacent symbol pairs. Segmented words are kept in a
+// sharded, size bounded cache.
 class BPE : public Processor {
-  using BPEPair = std::pair<std::string, std::string>;
-
   public:
     BPE();
     BPE(std::ifstream&& file, const std::string sep = "@@");
 
     BPE(const std::string& path, const std::string sep = "@@");
 
-    std::vector<std::string> Segment(const std::string& sentence);
-
-    void PrintSegment(const std::string& sentence);
-
-    std::vector<std::string>& Encode(const std::string& word);
+    // Appends the space separated segments of `word` to `output`.
+    void Encode(boost::string_view word, std::string& output);
 
-    std::vector<std::string> Encode(const std::vector<std::string>& words);
+    void Preprocess(boost::string_view input, std::string& output);
+    void Postprocess(boost::string_view input, std::string& output);
 
-    std::vector<std::string> Preprocess(const std::vector<std::string> input);
-    std::vector<std::string> Postprocess(const std::vector<std::string> input);
+    void GetMemory(MemoryUsage& usage) const;
 
     virtual ~BPE() {}
   private:
-    std::set<BPEPair> GetPairs(const std::vector<std::string>& word);
+    typedef uint32_t Symbol;
+    static const Symbol NO_SYMBOL = static_cast<Symbol>(-1);
 
-    const BPEPair* FindBestBigram(const std::set<BPEPair>& pairs);
+    struct Merge {
+      size_t rank;
+      Symbol merged;
+    };
 
-    bool IsCached(const std::string& word) const;
+    struct CachedWord {
+      std::string word;
+      std::string encoded;
+    };
 
-    std::vector<std::string> SplitWordIntoLetters(const std::string& word) const;
+    // Keyed by the hash of the word so lookups need no string copy.
+    struct CacheShard {
+      mutable std::mutex mutex;
+      std::unordered_map<size_t, CachedWord> words;
+    };
+    static const size_t CACHE_SHARDS = 16;
 
-    bool EndsWith(const std::string& fullString, const std::string suffix) const;
+    Symbol Intern(const std::string& symbol);
+    Symbol Lookup(const char* data, size_t length) const;
+    const Merge* FindMerge(Symbol left, Symbol right) const;
 
-    std::unordered_map<BPEPair, size_t> bpeCodes_;
-    const std::string sep_;
-    std::unordered_map<std::string, std::vector<std::string>> cache_;
+    void Apply(boost::string_view word, std::string& output) const;
 
+    // Read-only after construction, shared by all threads.
+    std::unordered_map<std::string, Symbol> symbols_;
+    std::unordered_map<uint64_t, Merge> merges_;
+    const std::string sep_;
 
+    std::array<CacheShard, CACHE_SHARDS> cache_;
+    const size_t maxCachedPerShard_;
 };
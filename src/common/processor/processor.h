@@ -1,12 +1,22 @@
 #pragma once
 
 #include <string>
-#include <vector>
 #include <memory>
+#include <boost/utility/string_view.hpp>
 
+#include "common/memory_report.h"
+
+// Processors work on lines of space separated tokens. They read a view of
+// their input and append their output to a buffer owned by the caller, so
+// buffers can be reused from line to line.
 class Preprocessor {
   public:
-    virtual std::vector<std::string> Preprocess(const std::vector<std::string> input) = 0;
+    virtual void Preprocess(boost::string_view input, std::string& output) = 0;
+
+    // Adds the memory held by tables and caches, safe to call concurrently
+    // with Preprocess().
+    virtual void GetMemory(MemoryUsage&) const {}
+
     virtual ~Preprocessor() {}
 };
 
@@ -14,7 +24,7 @@ using PreprocessorPtr = std::unique_ptr<Preprocessor>;
 
 class Postprocessor {
   public:
-    virtual std::vector<std::string> Postprocess(const std::vector<std::string> input) = 0;
+    virtual void Postprocess(boost::string_view input, std::string& output) = 0;
     virtual ~Postprocessor() {}
 };
 using PostprocessorPtr = std::unique_ptr<Postprocessor>;
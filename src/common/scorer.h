@@ -6,6 +6,7 @@
 #include "common/hypothesis.h"
 #include "common/sentence.h"
 #include "common/base_matrix.h"
+#include "common/memory_report.h"
 #include "yaml-cpp/node/node.h"
 
 class State {
@@ -29,6 +30,23 @@ class State {
 typedef std::unique_ptr<State> StatePtr;
 typedef std::vector<StatePtr> States;
 
+// The words of a beam and the rows of the previous states they extend,
+// collected once per step for all scorers of an ensemble. Reset() keeps
+// the capacity, so a search reusing one BeamOrder does not allocate.
+struct BeamOrder {
+  std::vector<size_t> words;
+  std::vector<size_t> prevStates;
+
+  void Reset(const Beam& beam) {
+    words.clear();
+    prevStates.clear();
+    for (auto& h : beam) {
+      words.push_back(h->GetWord());
+      prevStates.push_back(h->GetPrevStateIndex());
+    }
+  }
+};
+
 class Scorer {
   public:
     Scorer(const std::string& name,
@@ -45,6 +63,15 @@ class Scorer {
                                    const Beam& beam,
                                    State& out) = 0;
 
+    // Same with the order of the beam already collected, which scorers
+    // can reorder their state with in place.
+    virtual void AssembleBeamState(const State& in,
+                                   const Beam& beam,
+                                   const BeamOrder& order,
+                                   State& out) {
+      AssembleBeamState(in, beam, out);
+    }
+
     virtual void SetSource(const Sentence& source) = 0;
 
     virtual void Filter(const std::vector<size_t>&) = 0;
@@ -55,6 +82,10 @@ class Scorer {
 
     virtual void CleanUpAfterSentence() {}
 
+    // Adds the host memory held by this scorer, not by the shared model.
+    // Called on the thread that scores.
+    virtual void GetMemory(MemoryUsage&) const {}
+
     virtual const std::string& GetName() const {
       return name_;
     }
@@ -6,12 +6,42 @@
 #include "common/history.h"
 #include "common/filter.h"
 #include "common/base_matrix.h"
+#include "common/metrics.h"
+#include "common/timing.h"
+#include "common/trace.h"
 
 using namespace std;
 
+namespace {
+
+// A hypothesis, its separately allocated shared_ptr control block and its
+// slot in the beam.
+const size_t HYPOTHESIS_BYTES = sizeof(Hypothesis) + 2 * sizeof(HypothesisPtr);
+
+}
+
 Search::Search(size_t threadId)
   : scorers_(God::GetScorers(threadId)),
-    BestHyps_(God::GetBestHyps(threadId)) {
+    BestHyps_(God::GetBestHyps(threadId)),
+    hypotheses_(0) {
+  UpdateMemory();
+  memory_.Reset([this](MemoryUsage& usage) {
+    {
+      std::lock_guard<std::mutex> lock(memoryMutex_);
+      for (auto& component : scorerMemory_)
+        usage[component.first] += component.second;
+    }
+    usage["history"] += hypotheses_.load(std::memory_order_relaxed) * HYPOTHESIS_BYTES;
+  });
+}
+
+void Search::UpdateMemory() {
+  MemoryUsage usage;
+  for (auto& scorer : scorers_)
+    scorer->GetMemory(usage);
+
+  std::lock_guard<std::mutex> lock(memoryMutex_);
+  scorerMemory_.swap(usage);
 }
 
 
@@ -23,17 +53,18 @@ size_t Search::MakeFilter(const Words& srcWords, size_t vocabSize) {
   return filterIndices_.size();
 }
 
-History Search::Decode(const Sentence& sentence) {
+History Search::Decode(const Sentence& sentence, const DecoderOptions& options) {
   boost::timer::cpu_timer timer;
+  Timing::Clock::time_point start = Timing::Clock::now();
+  TraceScope traced("Search::Decode", sentence.GetLine());
 
-  size_t beamSize = God::Get<size_t>("beam-size");
-  bool normalize = God::Get<bool>("normalize");
+  size_t beamSize = options.beamSize;
 
   // @TODO Future: in order to do batch sentence decoding
   // it should be enough to keep track of hypotheses in
   // separate History objects.
 
-  History history;
+  History history(options);
   Beam prevHyps = { HypothesisPtr(new Hypothesis()) };
   history.Add(prevHyps);
 
@@ -42,44 +73,58 @@ History Search::Decode(const Sentence& sentence) {
 
   size_t vocabSize = scorers_[0]->GetVocabSize();
 
-  bool filter = God::Get<std::vector<std::string>>("softmax-filter").size();
-  if (filter) {
+  if (options.softmaxFilter) {
     vocabSize = MakeFilter(sentence.GetWords(), vocabSize);
   }
 
-  for (size_t i = 0; i < scorers_.size(); i++) {
-    Scorer &scorer = *scorers_[i];
-    scorer.SetSource(sentence);
+  {
+    ScopedTimer encoderTimer(Stage::Encoder);
+    for (size_t i = 0; i < scorers_.size(); i++) {
+      Scorer &scorer = *scorers_[i];
+      scorer.SetSource(sentence);
 
-    states[i].reset(scorer.NewState());
-    nextStates[i].reset(scorer.NewState());
+      states[i].reset(scorer.NewState());
+      nextStates[i].reset(scorer.NewState());
 
-    scorer.BeginSentenceState(*states[i]);
+      scorer.BeginSentenceState(*states[i]);
+    }
   }
 
   const size_t maxLength = sentence.GetWords().size() * 3;
   do {
-    for (size_t i = 0; i < scorers_.size(); i++) {
-      Scorer &scorer = *scorers_[i];
-      State &state = *states[i];
-      State &nextState = *nextStates[i];
-
-      // prob.Resize(beamSize, vocabSize);
-      scorer.Score(state, nextState);
+    if (Metrics::Active()) {
+      Metrics::AddStep(prevHyps.size());
     }
 
-    Beam hyps;
+    {
+      ScopedTimer decoderTimer(Stage::Decoder);
+      for (size_t i = 0; i < scorers_.size(); i++) {
+        Scorer &scorer = *scorers_[i];
+        State &state = *states[i];
+        State &nextState = *nextStates[i];
 
-    bool returnAlignment = God::Get<bool>("return-alignment");
+        // prob.Resize(beamSize, vocabSize);
+        scorer.Score(state, nextState);
+      }
+    }
 
-    BestHyps_(hyps, prevHyps, beamSize, scorers_, filterIndices_,
-                                     returnAlignment);
-    history.Add(hyps, history.size() == maxLength);
+    Beam hyps;
+    {
+      ScopedTimer bestHypsTimer(Stage::BestHyps);
+      BestHyps_(hyps, prevHyps, beamSize, scorers_, filterIndices_, options);
+    }
 
     Beam survivors;
-    for (auto h : hyps) {
-      if (h->GetWord() != EOS) {
-        survivors.push_back(h);
+    {
+      ScopedTimer historyTimer(Stage::History);
+      history.Add(hyps, history.size() == maxLength);
+      hypotheses_.store(hypotheses_.load(std::memory_order_relaxed) + hyps.size(),
+                        std::memory_order_relaxed);
+
+      for (auto h : hyps) {
+        if (h->GetWord() != EOS) {
+          survivors.push_back(h);
+        }
       }
     }
     beamSize = survivors.size();
@@ -87,8 +132,12 @@ History Search::Decode(const Sentence& sentence) {
       break;
     }
 
-    for (size_t i = 0; i < scorers_.size(); i++) {
-      scorers_[i]->AssembleBeamState(*nextStates[i], survivors, *states[i]);
+    {
+      ScopedTimer assembleTimer(Stage::AssembleBeam);
+      beamOrder_.Reset(survivors);
+      for (size_t i = 0; i < scorers_.size(); i++) {
+        scorers_[i]->AssembleBeamState(*nextStates[i], survivors, beamOrder_, *states[i]);
+      }
     }
 
     prevHyps.swap(survivors);
@@ -97,10 +146,15 @@ History Search::Decode(const Sentence& sentence) {
 
   LOG(progress) << "Line " << sentence.GetLine()
                 << ": Search took " << timer.format(3, "%ws");
+  if (Timing::Active()) {
+    Timing::AddSentence(sentence.GetWords().size() - 1, Timing::Clock::now() - start);
+  }
 
   for (auto scorer : scorers_) {
 	  scorer->CleanUpAfterSentence();
   }
+  hypotheses_.store(0, std::memory_order_relaxed);
+  UpdateMemory();
 
   return history;
 }
@@ -1,21 +1,35 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 
 #include "common/scorer.h"
 #include "common/sentence.h"
 #include "common/base_best_hyps.h"
+#include "common/decoder_options.h"
+#include "common/memory_report.h"
 
 class History;
 
 class Search {
   public:
     Search(size_t threadId);
-    History Decode(const Sentence& sentence);
+    History Decode(const Sentence& sentence, const DecoderOptions& options);
 
   private:
     size_t MakeFilter(const Words& srcWords, size_t vocabSize);
+    void UpdateMemory();
+
     std::vector<ScorerPtr> scorers_;
     Words filterIndices_;
+    BeamOrder beamOrder_;
     BestHypsType BestHyps_;
+
+    // Scorer buffers are only read between sentences, the number of
+    // hypotheses of the current sentence at any time.
+    std::mutex memoryMutex_;
+    MemoryUsage scorerMemory_;
+    std::atomic<size_t> hypotheses_;
+    MemorySource memory_;
 };
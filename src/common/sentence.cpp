@@ -1,27 +1,40 @@
 #include "sentence.h"
 #include "god.h"
 #include "utils.h"
+#include "common/timing.h"
+#include "common/trace.h"
 #include "common/vocab.h"
 
 Sentence::Sentence(size_t lineNo, const std::string& line)
-: lineNo_(lineNo), line_(line)
+: lineNo_(lineNo)
 {
-  std::vector<std::string> tabs;
-  Split(line, tabs, "\t");
+  TraceSentence traced(lineNo);
+  ScopedTimer timer(Stage::Preprocess);
+  std::string buffer, scratch;
   size_t i = 0;
-  for(auto&& tab : tabs) {
-    std::vector<std::string> lineTokens;
-    Trim(tab);
-    Split(tab, lineTokens, " ");
-    auto processed = God::Preprocess(i, lineTokens);
-    words_.push_back(God::GetSourceVocab(i++)(processed));
-  }
+  auto addTab = [&](boost::string_view tab) {
+    boost::string_view processed = God::Preprocess(i, Trim(tab), buffer, scratch);
+    words_.emplace_back();
+    God::GetSourceVocab(i++)(processed, words_.back());
+  };
+
+  ForEachPiece(line, '\t', addTab);
+  if(words_.empty())
+    addTab(boost::string_view());
 }
 
+Sentence::Sentence(size_t lineNo, std::vector<Words>&& words)
+: words_(std::move(words)), lineNo_(lineNo)
+{}
+
 const Words& Sentence::GetWords(size_t index) const {
   return words_[index];
 }
 
+size_t Sentence::size() const {
+  return words_.size();
+}
+
 size_t Sentence::GetLine() const {
   return lineNo_;
 }
@@ -1,19 +1,25 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <memory>
 #include "types.h"
 
 class Sentence {
   public:
     Sentence(size_t lineNo, const std::string& line);
+
+    // Already numericized input, one id sequence per tab.
+    Sentence(size_t lineNo, std::vector<Words>&& words);
     
     const Words& GetWords(size_t index = 0) const;
+
+    size_t size() const;
     
     size_t GetLine() const;
     
   private:
     std::vector<Words> words_;
     size_t lineNo_;
-    std::string line_;
 };
 
+typedef std::shared_ptr<Sentence> SentencePtr;
@@ -0,0 +1,105 @@
+#include "common/server.h"
+
+#include <future>
+#include <thread>
+#include <vector>
+#include <boost/lexical_cast.hpp>
+
+#include "common/god.h"
+#include "common/logging.h"
+#include "common/translation_task.h"
+
+using boost::asio::ip::tcp;
+
+TranslationServer::TranslationServer(const std::string& host, size_t port, size_t threads)
+  : acceptor_(io_, tcp::endpoint(boost::asio::ip::make_address(host), port)),
+    pool_(threads, TranslationWorkerInit())
+{
+  LOG(info) << "Listening on " << host << ":" << port
+            << " with " << threads << " decoding threads";
+
+  size_t batchTokens = God::Get<size_t>("batch-tokens");
+  if(batchTokens > 0) {
+    size_t maxWait = God::Get<size_t>("batch-max-wait");
+    LOG(info) << "Batching up to " << batchTokens << " tokens or "
+              << maxWait << "ms";
+    batcher_.reset(new DynamicBatcher(pool_, batchTokens,
+                                      std::chrono::milliseconds(maxWait)));
+  }
+}
+
+void TranslationServer::Run() {
+  for(;;) {
+    tcp::socket socket(io_);
+    boost::system::error_code ec;
+    acceptor_.accept(socket, ec);
+    if(ec) {
+      LOG(info) << "Accept failed: " << ec.message();
+      continue;
+    }
+    std::thread(&TranslationServer::Serve, this, std::move(socket)).detach();
+  }
+}
+
+void TranslationServer::Serve(tcp::socket socket) {
+  boost::system::error_code ec;
+  std::string peer = boost::lexical_cast<std::string>(socket.remote_endpoint(ec));
+  LOG(info) << "Client connected: " << peer;
+
+  boost::asio::streambuf buffer;
+  std::istream in(&buffer);
+  size_t lineNo = 0;
+
+  std::vector<std::future<std::string>> results;
+  auto submit = [&](std::string& line) {
+    if(!line.empty() && line.back() == '\r')
+      line.pop_back();
+
+    SentencePtr sentence(new Sentence(lineNo, line));
+    if(batcher_)
+      results.emplace_back(batcher_->Add(sentence));
+    else
+      results.emplace_back(pool_.enqueue([=]{ return PrintedTranslationTask(sentence); }));
+    ++lineNo;
+  };
+  auto reply = [&]() {
+    std::string out;
+    for(auto& result : results)
+      out += result.get();
+    results.clear();
+    boost::asio::write(socket, boost::asio::buffer(out), ec);
+    return !ec;
+  };
+
+  try {
+    while(boost::asio::read_until(socket, buffer, '\n', ec)) {
+      // Everything that is already buffered forms one request, its sentences
+      // are enqueued at once next to those of the other clients.
+      std::string line;
+      while(buffer.size() > 0 && std::getline(in, line)) {
+        if(in.eof()) {
+          // incomplete line, put it back and wait for the rest
+          std::ostream(&buffer) << line;
+          in.clear();
+          break;
+        }
+        submit(line);
+      }
+      if(!reply())
+        break;
+    }
+
+    // A client that half-closes after a last line without a newline still
+    // gets its translation.
+    if(ec == boost::asio::error::eof && buffer.size() > 0) {
+      std::string line(boost::asio::buffers_begin(buffer.data()),
+                       boost::asio::buffers_end(buffer.data()));
+      submit(line);
+      reply();
+    }
+  }
+  catch(std::exception& e) {
+    LOG(info) << "Error while serving " << peer << ": " << e.what();
+  }
+  LOG(info) << "Client disconnected: " << peer;
+}
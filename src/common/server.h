@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+
+#include "common/batcher.h"
+#include "common/threadpool.h"
+
+// Line-based TCP translation service. Every line a client sends is one
+// sentence, the reply is exactly what amun would print for it on stdout.
+// Lines that arrive together are decoded together, and sentences from all
+// connections share one persistent pool of decoding threads. With a batch
+// token budget, sentences are grouped by a DynamicBatcher first.
+class TranslationServer {
+  public:
+    TranslationServer(const std::string& host, size_t port, size_t threads);
+
+    // Accepts connections until the process is terminated.
+    void Run();
+
+  private:
+    void Serve(boost::asio::ip::tcp::socket socket);
+
+    boost::asio::io_context io_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    ThreadPool pool_;
+    std::unique_ptr<DynamicBatcher> batcher_;
+};
@@ -0,0 +1,63 @@
+#include "common/startup_timeline.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "common/logging.h"
+
+namespace {
+
+double Seconds(StartupTimeline::Clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+}
+
+StartupTimeline::StartupTimeline()
+  : start_(Clock::now()) {}
+
+StartupTimeline::Step StartupTimeline::Run(const std::string& name,
+                                           std::function<void()> task,
+                                           std::vector<Step> after) {
+  Step step = std::async(std::launch::async, [this, name, task, after] {
+    for (auto& previous : after)
+      previous.get();
+
+    Clock::time_point begin = Clock::now();
+    task();
+    Clock::time_point end = Clock::now();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back(Entry{ name, begin, end });
+  }).share();
+  steps_.push_back(step);
+  return step;
+}
+
+void StartupTimeline::Wait() {
+  // every step has to finish before the first failure is rethrown, tasks
+  // refer to this object
+  for (auto& step : steps_)
+    step.wait();
+  for (auto& step : steps_)
+    step.get();
+}
+
+void StartupTimeline::Log() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::sort(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+    return a.begin < b.begin;
+  });
+
+  std::stringstream total;
+  total << std::fixed << std::setprecision(2) << Seconds(Clock::now() - start_);
+  LOG(info) << "Startup took " << total.str() << "s:";
+  for (auto& entry : entries_) {
+    std::stringstream line;
+    line << std::fixed << std::setprecision(2)
+         << std::setw(7) << Seconds(entry.begin - start_) << "s - "
+         << std::setw(7) << Seconds(entry.end - start_) << "s  " << entry.name;
+    LOG(info) << line.str();
+  }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Independent startup steps (vocabularies, models, BPE codes, the softmax
+// filter) run as concurrent tasks. Every step is recorded with the time it
+// started and finished, and Log() prints them as a timeline, which shows
+// what bounds the startup time.
+//
+// Tasks must not read the configuration through God, which is not safe to
+// read from several threads. Read options before starting a step.
+class StartupTimeline {
+  public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::shared_future<void> Step;
+
+    StartupTimeline();
+
+    // Runs `task` on its own thread once all steps in `after` have finished.
+    Step Run(const std::string& name, std::function<void()> task,
+             std::vector<Step> after = std::vector<Step>());
+
+    // Waits for all steps, rethrows the first failure.
+    void Wait();
+
+    void Log();
+
+  private:
+    struct Entry {
+      std::string name;
+      Clock::time_point begin;
+      Clock::time_point end;
+    };
+
+    Clock::time_point start_;
+
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+
+    // Last, so running tasks are waited for before the entries go away.
+    std::vector<Step> steps_;
+};
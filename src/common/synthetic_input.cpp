@@ -0,0 +1,52 @@
+#include "common/synthetic_input.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "common/exception.h"
+#include "common/god.h"
+#include "common/vocab.h"
+
+namespace {
+
+size_t SourceTabs() {
+  if(God::Get("source-vocab").IsSequence())
+    return God::Get("source-vocab").size();
+  return 1;
+}
+
+}
+
+SyntheticInput::SyntheticInput(size_t sentences, float meanLength, float stddevLength,
+                               size_t maxLength, unsigned seed)
+  : sentences_(sentences), maxLength_(maxLength), lineNo_(0),
+    rng_(seed), length_(meanLength, stddevLength)
+{
+  UTIL_THROW_IF2(maxLength_ == 0, "Maximum benchmark sentence length is 0");
+  for(size_t i = 0; i < SourceTabs(); ++i)
+    UTIL_THROW_IF2(God::GetSourceVocab(i).size() <= 2,
+                   "Source vocabulary " << i << " has no words besides </s> and UNK");
+}
+
+bool SyntheticInput::Pop(SentencePtr& sentence) {
+  if(lineNo_ == sentences_)
+    return false;
+
+  float drawn = std::round(length_(rng_));
+  size_t length = std::min<size_t>(std::max(drawn, 1.0f), maxLength_);
+  sentence = MakeSentence(lineNo_++, length, rng_);
+  return true;
+}
+
+SentencePtr SyntheticInput::MakeSentence(size_t lineNo, size_t length, std::mt19937& rng) {
+  std::vector<Words> words(SourceTabs());
+  for(size_t i = 0; i < words.size(); ++i) {
+    std::uniform_int_distribution<size_t> word(2, God::GetSourceVocab(i).size() - 1);
+    words[i].reserve(length + 1);
+    for(size_t j = 0; j < length; ++j)
+      words[i].push_back(word(rng));
+    words[i].push_back(EOS);
+  }
+  return SentencePtr(new Sentence(lineNo, std::move(words)));
+}
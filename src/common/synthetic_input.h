@@ -0,0 +1,28 @@
+#pragma once
+
+#include <random>
+
+#include "common/input.h"
+
+// Random source sentences for benchmarking without a test set. Lengths are
+// drawn from a normal distribution clamped to [1, maxLength], words
+// uniformly from each source vocabulary except </s> and UNK. The corpus
+// only depends on the parameters and the seed.
+class SyntheticInput : public Input {
+  public:
+    SyntheticInput(size_t sentences, float meanLength, float stddevLength,
+                   size_t maxLength, unsigned seed = 1234);
+
+    bool Pop(SentencePtr& sentence);
+
+    // A random sentence of `length` words for line `lineNo`.
+    static SentencePtr MakeSentence(size_t lineNo, size_t length, std::mt19937& rng);
+
+  private:
+    const size_t sentences_;
+    const size_t maxLength_;
+    size_t lineNo_;
+
+    std::mt19937 rng_;
+    std::normal_distribution<float> length_;
+};
@@ -33,17 +33,26 @@ freely, subject to the following restrictions:
 #include <condition_variable>
 #include <future>
 #include <functional>
+#include <exception>
 #include <stdexcept>
 
+#include "common/metrics.h"
+#include "common/trace.h"
+
 class ThreadPool {
 public:
-    ThreadPool(size_t);
+    // `init` runs on every worker with its index before the worker takes
+    // tasks, the constructor returns once all workers are initialized and
+    // rethrows the first exception thrown by `init`
+    ThreadPool(size_t, std::function<void(size_t)> init = nullptr);
     template<class F, class... Args>
     auto enqueue(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
     ~ThreadPool();
     
 private:
+    void join();
+
     // need to keep track of threads so we can join them
     std::vector< std::thread > workers;
     // the task queue
@@ -53,16 +62,38 @@ private:
     std::mutex queue_mutex;
     std::condition_variable condition;
     bool stop;
+
+    // workers still running `init`
+    size_t initializing;
+    std::condition_variable initialized;
+    std::exception_ptr init_error;
 };
 
-// the constructor just launches some amount of workers
-inline ThreadPool::ThreadPool(size_t threads)
-    :   stop(false)
+// the constructor launches some amount of workers and waits for their
+// initialization
+inline ThreadPool::ThreadPool(size_t threads, std::function<void(size_t)> init)
+    :   stop(false), initializing(init ? threads : 0)
 {
     for(size_t i = 0;i<threads;++i)
         workers.emplace_back(
-            [this]
+            [this, i, init]
             {
+                if(init)
+                {
+                    std::exception_ptr error;
+                    try {
+                        init(i);
+                    } catch(...) {
+                        error = std::current_exception();
+                    }
+
+                    std::unique_lock<std::mutex> lock(this->queue_mutex);
+                    if(error && !this->init_error)
+                        this->init_error = error;
+                    if(--this->initializing == 0)
+                        this->initialized.notify_all();
+                }
+
                 for(;;)
                 {
                     std::function<void()> task;
@@ -75,12 +106,25 @@ inline ThreadPool::ThreadPool(size_t threads)
                             return;
                         task = std::move(this->tasks.front());
                         this->tasks.pop();
+                        Metrics::TaskStarted();
                     }
 
                     task();
                 }
             }
         );
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        initialized.wait(lock, [this]{ return initializing == 0; });
+        error = init_error;
+    }
+    if(error)
+    {
+        join();
+        std::rethrow_exception(error);
+    }
 }
 
 // add new work item to the pool
@@ -102,7 +146,18 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
         if(stop)
             throw std::runtime_error("enqueue on stopped ThreadPool");
 
-        tasks.emplace([task](){ (*task)(); });
+        // sampled tasks are traced from being queued until they start
+        if(Trace::SampleTask()) {
+            auto queued = Trace::Clock::now();
+            tasks.emplace([task, queued](){
+                if(Trace::Enabled())
+                    Trace::Add("queue wait", queued, Trace::Clock::now());
+                (*task)();
+            });
+        }
+        else
+            tasks.emplace([task](){ (*task)(); });
+        Metrics::TaskQueued();
     }
     condition.notify_one();
     return res;
@@ -110,6 +165,11 @@ auto ThreadPool::enqueue(F&& f, Args&&... args)
 
 // the destructor joins all threads
 inline ThreadPool::~ThreadPool()
+{
+    join();
+}
+
+inline void ThreadPool::join()
 {
     {
         std::unique_lock<std::mutex> lock(queue_mutex);
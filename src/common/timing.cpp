@@ -0,0 +1,247 @@
+#include "common/timing.h"
+
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef __APPLE__
+#include <boost/thread/tss.hpp>
+#endif
+
+#include "common/exception.h"
+#include "common/logging.h"
+
+namespace {
+
+const char* STAGE_NAMES[] = {
+  "preprocess",
+  "encoder",
+  "decoder",
+  "decoder.hidden",
+  "decoder.attention",
+  "decoder.second_gru",
+  "decoder.softmax",
+  "best_hyps",
+  "assemble_beam",
+  "history",
+  "print"
+};
+const size_t STAGES = static_cast<size_t>(Stage::Count);
+static_assert(sizeof(STAGE_NAMES) / sizeof(STAGE_NAMES[0]) == STAGES,
+              "Every stage needs a name");
+
+// Source lengths up to and including each bound, the last bucket is open.
+const size_t LENGTH_BOUNDS[] = { 10, 20, 30, 50, 80 };
+const size_t LENGTH_BUCKETS = sizeof(LENGTH_BOUNDS) / sizeof(LENGTH_BOUNDS[0]) + 1;
+
+// Latencies in milliseconds up to each bound, the last bucket is open.
+const double LATENCY_BOUNDS[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000 };
+const size_t LATENCY_BUCKETS = sizeof(LATENCY_BOUNDS) / sizeof(LATENCY_BOUNDS[0]) + 1;
+
+// Written by the owning thread only, read by the reporter.
+struct Counters {
+  bool paused = false;
+  std::atomic<uint64_t> nanos[STAGES];
+  std::atomic<uint64_t> calls[STAGES];
+  std::atomic<uint64_t> sentenceNanos[LENGTH_BUCKETS];
+  std::atomic<uint64_t> histogram[LENGTH_BUCKETS][LATENCY_BUCKETS];
+
+  Counters() {
+    for(size_t i = 0; i < STAGES; ++i)
+      nanos[i] = calls[i] = 0;
+    for(size_t i = 0; i < LENGTH_BUCKETS; ++i) {
+      sentenceNanos[i] = 0;
+      for(size_t j = 0; j < LATENCY_BUCKETS; ++j)
+        histogram[i][j] = 0;
+    }
+  }
+};
+
+inline void Increment(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value,
+                std::memory_order_relaxed);
+}
+
+// Counters of all threads that ever timed something. They are never freed,
+// so time spent on threads that have finished still shows up in the report.
+std::mutex registryMutex;
+std::vector<std::unique_ptr<Counters>> registry;
+
+Counters* Register() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry.emplace_back(new Counters());
+  return registry.back().get();
+}
+
+Counters& Local() {
+#ifdef __APPLE__
+  static boost::thread_specific_ptr<Counters> local([](Counters*) {});
+  if(!local.get())
+    local.reset(Register());
+  return *local;
+#else
+  thread_local Counters* local = Register();
+  return *local;
+#endif
+}
+
+std::mutex reporterMutex;
+std::condition_variable reporterStop;
+bool stopping = false;
+std::thread reporter;
+std::string reportPath;
+
+void Report() {
+  if(reportPath.empty()) {
+    std::stringstream json;
+    Timing::WriteJson(json);
+    LOG(info) << "Timing: " << json.str();
+  }
+  else {
+    std::ofstream out(reportPath);
+    UTIL_THROW_IF2(!out, "Cannot write timing summary to " << reportPath);
+    Timing::WriteJson(out);
+    out << std::endl;
+  }
+}
+
+// On the reporter thread an exception would end the program.
+void ReportOrLog() {
+  try {
+    Report();
+  }
+  catch(std::exception& e) {
+    LOG(info) << "Timing: " << e.what();
+  }
+}
+
+}
+
+std::atomic<bool> Timing::enabled_(false);
+
+bool Timing::Paused() {
+  return Local().paused;
+}
+
+bool Timing::SetPaused(bool paused) {
+  bool previous = Local().paused;
+  Local().paused = paused;
+  return previous;
+}
+
+void Timing::Add(Stage stage, Clock::duration elapsed) {
+  Counters& counters = Local();
+  size_t i = static_cast<size_t>(stage);
+  Increment(counters.nanos[i],
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  Increment(counters.calls[i], 1);
+}
+
+void Timing::AddSentence(size_t sourceLength, Clock::duration elapsed) {
+  size_t length = 0;
+  while(length < LENGTH_BUCKETS - 1 && sourceLength > LENGTH_BOUNDS[length])
+    ++length;
+
+  double ms = std::chrono::duration<double, std::milli>(elapsed).count();
+  size_t latency = 0;
+  while(latency < LATENCY_BUCKETS - 1 && ms > LATENCY_BOUNDS[latency])
+    ++latency;
+
+  Counters& counters = Local();
+  Increment(counters.sentenceNanos[length],
+            std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  Increment(counters.histogram[length][latency], 1);
+}
+
+void Timing::Start(const std::string& path, size_t intervalSeconds) {
+  // fail on this thread rather than in the reporter
+  UTIL_THROW_IF2(!path.empty() && !std::ofstream(path),
+                 "Cannot write timing summary to " << path);
+  reportPath = path;
+  enabled_ = true;
+  if(intervalSeconds == 0)
+    return;
+
+  stopping = false;
+  reporter = std::thread([intervalSeconds] {
+    std::unique_lock<std::mutex> lock(reporterMutex);
+    while(!reporterStop.wait_for(lock, std::chrono::seconds(intervalSeconds),
+                                 [] { return stopping; }))
+      ReportOrLog();
+  });
+}
+
+void Timing::Stop() {
+  if(!Enabled())
+    return;
+
+  if(reporter.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(reporterMutex);
+      stopping = true;
+    }
+    reporterStop.notify_one();
+    reporter.join();
+  }
+  Report();
+  enabled_ = false;
+}
+
+const char* Timing::Name(Stage stage) {
+  return STAGE_NAMES[static_cast<size_t>(stage)];
+}
+
+void Timing::WriteJson(std::ostream& out) {
+  uint64_t nanos[STAGES] = {}, calls[STAGES] = {};
+  uint64_t sentenceNanos[LENGTH_BUCKETS] = {};
+  uint64_t histogram[LENGTH_BUCKETS][LATENCY_BUCKETS] = {};
+  {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for(auto& counters : registry) {
+      for(size_t i = 0; i < STAGES; ++i) {
+        nanos[i] += counters->nanos[i].load(std::memory_order_relaxed);
+        calls[i] += counters->calls[i].load(std::memory_order_relaxed);
+      }
+      for(size_t i = 0; i < LENGTH_BUCKETS; ++i) {
+        sentenceNanos[i] += counters->sentenceNanos[i].load(std::memory_order_relaxed);
+        for(size_t j = 0; j < LATENCY_BUCKETS; ++j)
+          histogram[i][j] += counters->histogram[i][j].load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  out << "{\"stages\": {";
+  for(size_t i = 0; i < STAGES; ++i) {
+    out << (i ? ", " : "") << "\"" << STAGE_NAMES[i] << "\": {\"seconds\": "
+        << nanos[i] * 1e-9 << ", \"calls\": " << calls[i] << "}";
+  }
+
+  out << "}, \"sentences\": {";
+  for(size_t i = 0; i < LENGTH_BUCKETS; ++i) {
+    uint64_t count = 0;
+    for(size_t j = 0; j < LATENCY_BUCKETS; ++j)
+      count += histogram[i][j];
+
+    out << (i ? ", " : "") << "\"";
+    size_t from = i ? LENGTH_BOUNDS[i - 1] + 1 : 1;
+    if(i < LENGTH_BUCKETS - 1)
+      out << from << "-" << LENGTH_BOUNDS[i];
+    else
+      out << from << "+";
+    out << "\": {\"count\": " << count << ", \"seconds\": " << sentenceNanos[i] * 1e-9
+        << ", \"latency_ms\": {";
+    for(size_t j = 0; j < LATENCY_BUCKETS; ++j) {
+      out << (j ? ", " : "") << "\"";
+      if(j < LATENCY_BUCKETS - 1)
+        out << "<=" << LATENCY_BOUNDS[j];
+      else
+        out << ">" << LATENCY_BOUNDS[j - 1];
+      out << "\": " << histogram[i][j];
+    }
+    out << "}}";
+  }
+  out << "}}";
+}
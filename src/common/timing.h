@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "common/trace.h"
+
+// Where decoding time goes (option timing). Every thread adds to its own
+// counters, which are only summed up when a report is written, so timing a
+// stage costs two clock reads. Stages nest: the decoder.* stages are part of
+// decoder, which times Scorer::Score. The decoder sub-stages are only
+// measured by the CPU decoder. Timed stages also show up in traces.
+enum class Stage {
+  Preprocess,
+  Encoder,
+  Decoder,
+  DecoderHidden,
+  DecoderAttention,
+  DecoderSecondGRU,
+  DecoderSoftmax,
+  BestHyps,
+  AssembleBeam,
+  History,
+  Print,
+  Count
+};
+
+class Timing {
+  public:
+    typedef Trace::Clock Clock;
+
+    static bool Enabled() {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Whether the calling thread's work is timed: timing is enabled and not
+    // paused by a TimingPause on this thread.
+    static bool Active() {
+      return Enabled() && !Paused();
+    }
+
+    static void Add(Stage stage, Clock::duration elapsed);
+
+    // Whole search time of a sentence, for the latency histograms.
+    static void AddSentence(size_t sourceLength, Clock::duration elapsed);
+
+    // Enables timing. The summary is written to `path`, or logged if it is
+    // empty, every `intervalSeconds` if that is not 0 and by Stop().
+    static void Start(const std::string& path, size_t intervalSeconds);
+    static void Stop();
+
+    static void WriteJson(std::ostream& out);
+
+    static const char* Name(Stage stage);
+
+  private:
+    friend class TimingPause;
+
+    static bool Paused();
+    static bool SetPaused(bool paused);
+
+    static std::atomic<bool> enabled_;
+};
+
+// Leaves the calling thread's work out of the timing summary for its
+// lifetime, e.g. warm-up decodes.
+class TimingPause {
+  public:
+    TimingPause() : previous_(Timing::SetPaused(true)) {}
+    ~TimingPause() { Timing::SetPaused(previous_); }
+
+  private:
+    bool previous_;
+};
+
+// Times its own lifetime as `stage` when timing is enabled, and records it
+// when the current sentence is traced.
+class ScopedTimer {
+  public:
+    ScopedTimer(Stage stage)
+      : stage_(stage), timing_(Timing::Active()), tracing_(Trace::Sampled())
+    {
+      if(timing_ || tracing_)
+        start_ = Timing::Clock::now();
+    }
+
+    ~ScopedTimer() {
+      if(!timing_ && !tracing_)
+        return;
+      Timing::Clock::time_point end = Timing::Clock::now();
+      if(timing_)
+        Timing::Add(stage_, end - start_);
+      if(tracing_)
+        Trace::Add(Timing::Name(stage_), start_, end);
+    }
+
+  private:
+    Stage stage_;
+    bool timing_;
+    bool tracing_;
+    Timing::Clock::time_point start_;
+};
@@ -0,0 +1,237 @@
+#include "common/trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __APPLE__
+#include <boost/thread/tss.hpp>
+#endif
+
+#include "common/exception.h"
+#include "common/logging.h"
+
+namespace {
+
+struct Event {
+  const char* name;
+  int64_t begin;
+  int64_t end;
+  int64_t line;
+};
+
+// A ring buffer slot guarded like a seqlock. `sequence` is 2 * n + 1 while
+// event n is written into the slot and 2 * n + 2 once it is complete, so the
+// writer of the trace can tell whether the slot changed while it was read.
+struct Slot {
+  std::atomic<uint64_t> sequence;
+  std::atomic<const char*> name;
+  std::atomic<int64_t> begin;
+  std::atomic<int64_t> end;
+  std::atomic<int64_t> line;
+
+  Slot() : sequence(0), name(nullptr), begin(0), end(0), line(-1) {}
+};
+
+// Written by the owning thread only. `head` counts all events ever added,
+// the buffer holds the last `slots.size()` of them.
+struct Buffer {
+  size_t tid;
+  std::vector<Slot> slots;
+  std::atomic<uint64_t> head;
+
+  Buffer(size_t id, size_t size) : tid(id), slots(size), head(0) {}
+
+  void Put(const Event& event) {
+    uint64_t n = head.load(std::memory_order_relaxed);
+    Slot& slot = slots[n % slots.size()];
+    slot.sequence.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.begin.store(event.begin, std::memory_order_relaxed);
+    slot.end.store(event.end, std::memory_order_relaxed);
+    slot.line.store(event.line, std::memory_order_relaxed);
+    slot.sequence.store(2 * n + 2, std::memory_order_release);
+    head.store(n + 1, std::memory_order_release);
+  }
+
+  // Reads event n, false if it has been overwritten or is being written.
+  bool Get(uint64_t n, Event& event) const {
+    const Slot& slot = slots[n % slots.size()];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if(sequence != 2 * n + 2)
+      return false;
+    event.name = slot.name.load(std::memory_order_relaxed);
+    event.begin = slot.begin.load(std::memory_order_relaxed);
+    event.end = slot.end.load(std::memory_order_relaxed);
+    event.line = slot.line.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == sequence;
+  }
+};
+
+size_t bufferEvents = 0;
+size_t sampleEvery = 1;
+std::string tracePath;
+Trace::Clock::time_point traceStart;
+std::atomic<uint64_t> tasks(0);
+
+// Buffers of all threads that ever traced something, kept until the trace
+// has been written.
+std::mutex registryMutex;
+std::vector<std::unique_ptr<Buffer>> registry;
+
+struct ThreadState {
+  Buffer* buffer = nullptr;
+  int64_t line = -1;
+};
+
+ThreadState& Local() {
+#ifdef __APPLE__
+  static boost::thread_specific_ptr<ThreadState> local;
+  if(!local.get())
+    local.reset(new ThreadState());
+  return *local;
+#else
+  thread_local ThreadState local;
+  return local;
+#endif
+}
+
+Buffer& LocalBuffer() {
+  ThreadState& state = Local();
+  if(!state.buffer) {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    registry.emplace_back(new Buffer(registry.size() + 1, bufferEvents));
+    state.buffer = registry.back().get();
+  }
+  return *state.buffer;
+}
+
+inline int64_t Micros(Trace::Clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(t - traceStart).count();
+}
+
+std::mutex writerMutex;
+std::condition_variable writerStop;
+bool stopping = false;
+std::thread timer;
+
+void Write() {
+  std::ofstream out(tracePath);
+  UTIL_THROW_IF2(!out, "Cannot write trace to " << tracePath);
+
+  size_t count = 0;
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for(auto& buffer : registry) {
+    out << (count++ ? ",\n" : "")
+        << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+        << buffer->tid << ", \"args\": {\"name\": \"thread " << buffer->tid << "\"}}";
+
+    // Scopes that started before tracing stopped may still be adding
+    // events, events whose slot is rewritten meanwhile are dropped.
+    uint64_t head = buffer->head.load(std::memory_order_acquire);
+    uint64_t size = buffer->slots.size();
+    uint64_t first = head > size ? head - size : 0;
+    Event event;
+    for(uint64_t i = first; i < head; ++i) {
+      if(!buffer->Get(i, event))
+        continue;
+      out << ",\n{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1"
+          << ", \"tid\": " << buffer->tid << ", \"ts\": " << event.begin
+          << ", \"dur\": " << event.end - event.begin;
+      if(event.line >= 0)
+        out << ", \"args\": {\"line\": " << event.line << "}";
+      out << "}";
+      ++count;
+    }
+  }
+  out << "\n]}" << std::endl;
+  LOG(info) << "Wrote " << count << " trace events to " << tracePath;
+}
+
+}
+
+std::atomic<bool> Trace::enabled_(false);
+
+bool Trace::SampledLine() {
+  int64_t line = Local().line;
+  return line >= 0 && line % sampleEvery == 0;
+}
+
+bool Trace::SampleTask() {
+  return Enabled()
+    && tasks.fetch_add(1, std::memory_order_relaxed) % sampleEvery == 0;
+}
+
+void Trace::Add(const char* name, Clock::time_point begin,
+                Clock::time_point end, int64_t line) {
+  if(!Enabled())
+    return;
+  LocalBuffer().Put(Event{ name, Micros(begin), Micros(end), line });
+}
+
+TraceSentence::TraceSentence(size_t line)
+  : previous_(Local().line)
+{
+  Local().line = line;
+}
+
+TraceSentence::~TraceSentence() {
+  Local().line = previous_;
+}
+
+void Trace::Start(const std::string& path, size_t events, size_t sample,
+                  size_t durationSeconds) {
+  UTIL_THROW_IF2(events == 0, "trace-buffer must hold at least 1 event");
+  UTIL_THROW_IF2(sample == 0, "trace-sample must be at least 1");
+  // fail on this thread rather than in the timer
+  UTIL_THROW_IF2(!std::ofstream(path), "Cannot write trace to " << path);
+  tracePath = path;
+  bufferEvents = events;
+  sampleEvery = sample;
+  traceStart = Clock::now();
+  stopping = false;
+  enabled_ = true;
+
+  if(durationSeconds > 0) {
+    timer = std::thread([durationSeconds] {
+      std::unique_lock<std::mutex> lock(writerMutex);
+      if(!writerStop.wait_for(lock, std::chrono::seconds(durationSeconds),
+                              [] { return stopping; })) {
+        lock.unlock();
+        // on the timer thread an exception would end the program
+        try {
+          Flush();
+        }
+        catch(std::exception& e) {
+          LOG(info) << "Trace: " << e.what();
+        }
+      }
+    });
+  }
+}
+
+void Trace::Stop() {
+  if(timer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(writerMutex);
+      stopping = true;
+    }
+    writerStop.notify_one();
+    timer.join();
+  }
+  Flush();
+}
+
+void Trace::Flush() {
+  std::lock_guard<std::mutex> lock(writerMutex);
+  if(!Enabled())
+    return;
+  enabled_ = false;
+  Write();
+}
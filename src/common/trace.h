@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Records what every thread is doing as Chrome trace events (option
+// trace-file), to be viewed in chrome://tracing or Perfetto. Each thread
+// writes complete events into its own fixed size ring buffer, so a trace
+// holds the most recent events of each thread and recording takes no lock.
+// Only every trace-sample'th sentence and queued task is recorded. The
+// trace is written after trace-duration seconds or at exit.
+class Trace {
+  public:
+    typedef std::chrono::steady_clock Clock;
+
+    static bool Enabled() {
+      return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // Whether the sentence the calling thread works on is traced.
+    static bool Sampled() {
+      return Enabled() && SampledLine();
+    }
+
+    // Whether the next queued task is traced.
+    static bool SampleTask();
+
+    // `name` must be a string literal, `line` is the sentence line number
+    // or -1.
+    static void Add(const char* name, Clock::time_point begin,
+                    Clock::time_point end, int64_t line = -1);
+
+    static void Start(const std::string& path, size_t bufferEvents,
+                      size_t sample, size_t durationSeconds);
+    static void Stop();
+
+  private:
+    static bool SampledLine();
+
+    // Stops recording and writes the trace, once.
+    static void Flush();
+
+    static std::atomic<bool> enabled_;
+};
+
+// Marks the calling thread as working on sentence `line` for its lifetime,
+// which is traced if the line is sampled.
+class TraceSentence {
+  public:
+    TraceSentence(size_t line);
+    ~TraceSentence();
+
+  private:
+    int64_t previous_;
+};
+
+// Records its own lifetime if the current sentence is traced.
+class TraceScope {
+  public:
+    TraceScope(const char* name, int64_t line = -1)
+      : name_(name), line_(line), active_(Trace::Sampled())
+    {
+      if(active_)
+        begin_ = Trace::Clock::now();
+    }
+
+    ~TraceScope() {
+      if(active_)
+        Trace::Add(name_, begin_, Trace::Clock::now(), line_);
+    }
+
+  private:
+    const char* name_;
+    int64_t line_;
+    bool active_;
+    Trace::Clock::time_point begin_;
+};
@@ -0,0 +1,341 @@
+#include "common/translation_cache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <yaml-cpp/yaml.h>
+
+#include "common/exception.h"
+#include "common/god.h"
+#include "common/logging.h"
+#include "common/utils.h"
+
+namespace {
+
+const size_t NUM_SHARDS = 16;
+const char MAGIC[8] = { 'A', 'M', 'U', 'N', 'C', 'C', 'H', '1' };
+
+// Word id that cannot occur in a vocabulary, separates the input tabs.
+const Word TAB_SEPARATOR = std::numeric_limits<Word>::max();
+
+inline uint64_t Mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+template <typename T>
+void Write(std::ostream& out, const T& value) {
+  out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T Read(const char*& it, const char* end) {
+  UTIL_THROW_IF2(it + sizeof(T) > end, "Truncated translation cache file");
+  T value;
+  std::memcpy(&value, it, sizeof(T));
+  it += sizeof(T);
+  return value;
+}
+
+// Appends the file names in a scalar or sequence option.
+void AddPaths(const YAML::Node& node, std::vector<std::string>& paths) {
+  if(node.IsScalar())
+    paths.push_back(node.as<std::string>());
+  else if(node.IsSequence())
+    for(auto&& item : node)
+      AddPaths(item, paths);
+}
+
+// Path, size and modification time of a file.
+std::string FileIdentity(const std::string& path) {
+  std::stringstream identity;
+  identity << path;
+  boost::system::error_code ec;
+  uintmax_t size = boost::filesystem::file_size(path, ec);
+  if(!ec)
+    identity << " " << size;
+  std::time_t mtime = boost::filesystem::last_write_time(path, ec);
+  if(!ec)
+    identity << " " << mtime;
+  return identity.str();
+}
+
+}
+
+size_t TranslationCache::Entry::Bytes() const {
+  // payload plus a rough estimate of list and hash map node overhead
+  return sizeof(Entry) + key.size() * sizeof(Word) + printed.size() + 64;
+}
+
+TranslationCache::TranslationCache(size_t maxBytes, const std::string& path,
+                                   size_t saveIntervalSeconds)
+  : maxBytes_(maxBytes), path_(path), hits_(0), misses_(0), stopping_(false)
+{
+  // Everything that changes what gets printed for a given input: the
+  // options and the files they name, which may be replaced at the same path.
+  std::stringstream options;
+  for(auto key : { "scorers", "weights", "beam-size", "normalize", "n-best",
+                   "wipo", "allow-unk", "softmax-filter", "no-debpe",
+                   "output-format", "source-vocab", "target-vocab", "bpe" })
+    if(God::Has(key))
+      options << key << ": " << YAML::Dump(God::Get(key)) << "\n";
+
+  std::vector<std::string> files;
+  for(auto key : { "source-vocab", "target-vocab", "bpe" })
+    if(God::Has(key))
+      AddPaths(God::Get(key), files);
+  auto filter = God::Get<std::vector<std::string>>("softmax-filter");
+  if(!filter.empty())
+    files.push_back(filter[0]);
+  for(auto&& scorer : God::Get("scorers"))
+    if(scorer.second["path"])
+      AddPaths(scorer.second["path"], files);
+  for(auto& file : files)
+    options << FileIdentity(file) << "\n";
+
+  std::string fingerprint = options.str();
+  fingerprint_ = Fnv1a(fingerprint.data(), fingerprint.size());
+
+  for(size_t i = 0; i < NUM_SHARDS; ++i)
+    shards_.emplace_back(new Shard());
+
+  if(!path_.empty() && boost::filesystem::exists(path_))
+    Load(path_);
+
+  // A server only stops when it is killed, so its cache is saved as it goes.
+  if(!path_.empty() && saveIntervalSeconds > 0) {
+    saver_ = std::thread([this, saveIntervalSeconds] {
+      std::unique_lock<std::mutex> lock(saverMutex_);
+      while(!saverStop_.wait_for(lock, std::chrono::seconds(saveIntervalSeconds),
+                                 [this] { return stopping_; })) {
+        try {
+          Save(path_);
+        }
+        catch(std::exception& e) {
+          LOG(info) << "Translation cache: " << e.what();
+        }
+      }
+    });
+  }
+}
+
+TranslationCache::~TranslationCache() {
+  if(saver_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(saverMutex_);
+      stopping_ = true;
+    }
+    saverStop_.notify_one();
+    saver_.join();
+  }
+
+  LOG(info) << "Translation cache: " << GetHits() << " hits, "
+            << GetMisses() << " misses, " << GetBytes() << " bytes";
+  if(!path_.empty())
+    Save(path_);
+}
+
+Words TranslationCache::MakeKey(const Sentence& sentence) {
+  Words key;
+  for(size_t i = 0; i < sentence.size(); ++i) {
+    if(i > 0)
+      key.push_back(TAB_SEPARATOR);
+    const Words& words = sentence.GetWords(i);
+    key.insert(key.end(), words.begin(), words.end());
+  }
+  return key;
+}
+
+uint64_t TranslationCache::Hash(const Words& key, size_t version) const {
+  uint64_t h = Mix(fingerprint_ ^ version);
+  for(auto word : key)
+    h = Mix(h ^ word) + 0x9e3779b97f4a7c15ULL;
+  return h;
+}
+
+TranslationCache::Shard& TranslationCache::GetShard(uint64_t hash) {
+  return *shards_[hash % NUM_SHARDS];
+}
+
+bool TranslationCache::Find(const Sentence& sentence, const DecoderOptions& options,
+                            std::string& out) {
+  Words key = MakeKey(sentence);
+  uint64_t hash = Hash(key, options.version);
+  Shard& shard = GetShard(hash);
+
+  size_t lineNo;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(hash);
+    if(it == shard.index.end() || it->second->key != key) {
+      ++misses_;
+      return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    out = it->second->printed;
+    lineNo = it->second->lineNo;
+  }
+  ++hits_;
+
+  if(lineNo != sentence.GetLine() && options.nBest && !options.binaryOutput)
+    out = Renumber(out, lineNo, sentence.GetLine());
+  return true;
+}
+
+void TranslationCache::Insert(const Sentence& sentence, const DecoderOptions& options,
+                              const std::string& printed) {
+  Entry entry;
+  entry.key = MakeKey(sentence);
+  entry.hash = Hash(entry.key, options.version);
+  entry.lineNo = sentence.GetLine();
+  entry.printed = printed;
+  Add(std::move(entry));
+}
+
+void TranslationCache::Add(Entry&& entry) {
+  size_t bytes = entry.Bytes();
+  size_t maxShardBytes = maxBytes_ / NUM_SHARDS;
+  if(bytes > maxShardBytes)
+    return;
+
+  Shard& shard = GetShard(entry.hash);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto it = shard.index.find(entry.hash);
+  if(it != shard.index.end()) {
+    shard.bytes -= it->second->Bytes();
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+  }
+
+  while(!shard.lru.empty() && shard.bytes + bytes > maxShardBytes) {
+    const Entry& last = shard.lru.back();
+    shard.bytes -= last.Bytes();
+    shard.index.erase(last.hash);
+    shard.lru.pop_back();
+  }
+
+  shard.lru.push_front(std::move(entry));
+  shard.index[shard.lru.front().hash] = shard.lru.begin();
+  shard.bytes += bytes;
+}
+
+std::string TranslationCache::Renumber(const std::string& printed,
+                                       size_t from, size_t to) {
+  std::string oldPrefix = std::to_string(from) + " |||";
+  std::string newPrefix = std::to_string(to) + " |||";
+
+  std::stringstream in(printed);
+  std::string out, line;
+  while(std::getline(in, line)) {
+    size_t start = line.compare(0, 5, "OUT: ") == 0 ? 5 : 0;
+    if(line.compare(start, oldPrefix.size(), oldPrefix) == 0)
+      line.replace(start, oldPrefix.size(), newPrefix);
+    out += line;
+    out += '\n';
+  }
+  return out;
+}
+
+size_t TranslationCache::GetHits() const {
+  return hits_;
+}
+
+size_t TranslationCache::GetMisses() const {
+  return misses_;
+}
+
+size_t TranslationCache::GetBytes() const {
+  size_t bytes = 0;
+  for(auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    bytes += shard->bytes;
+  }
+  return bytes;
+}
+
+void TranslationCache::Save(const std::string& path) const {
+  std::string tmpPath = path + ".tmp";
+  std::ofstream out(tmpPath, std::ios::binary);
+  UTIL_THROW_IF2(!out, "Cannot write translation cache to " << tmpPath);
+
+  out.write(MAGIC, sizeof(MAGIC));
+  Write<uint64_t>(out, fingerprint_);
+
+  size_t entries = 0;
+  for(auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    // oldest first, so that loading restores the recency order
+    for(auto it = shard->lru.rbegin(); it != shard->lru.rend(); ++it) {
+      Write<uint64_t>(out, it->hash);
+      Write<uint64_t>(out, it->lineNo);
+      Write<uint64_t>(out, it->key.size());
+      for(auto word : it->key)
+        Write<uint64_t>(out, word);
+      Write<uint64_t>(out, it->printed.size());
+      out.write(it->printed.data(), it->printed.size());
+      ++entries;
+    }
+  }
+  out.close();
+  std::rename(tmpPath.c_str(), path.c_str());
+  LOG(info) << "Saved " << entries << " cached translations to " << path;
+}
+
+void TranslationCache::Load(const std::string& path) {
+  boost::iostreams::mapped_file_source file(path);
+  const char* it = file.data();
+  const char* end = file.data() + file.size();
+
+  if(file.size() < sizeof(MAGIC) + sizeof(uint64_t)
+     || std::memcmp(it, MAGIC, sizeof(MAGIC)) != 0) {
+    LOG(info) << "Ignoring translation cache " << path << ": unknown format";
+    return;
+  }
+  it += sizeof(MAGIC);
+  if(Read<uint64_t>(it, end) != fingerprint_) {
+    LOG(info) << "Ignoring translation cache " << path
+              << ": created with different decoding options";
+    return;
+  }
+
+  // A corrupt file is ignored as a whole, counts are checked against the
+  // bytes left before anything is allocated for them.
+  std::vector<Entry> loaded;
+  try {
+    while(it < end) {
+      Entry entry;
+      entry.hash = Read<uint64_t>(it, end);
+      entry.lineNo = Read<uint64_t>(it, end);
+      uint64_t words = Read<uint64_t>(it, end);
+      UTIL_THROW_IF2(words > uint64_t(end - it) / sizeof(uint64_t),
+                     "Truncated translation cache file");
+      entry.key.resize(words);
+      for(auto& word : entry.key)
+        word = Read<uint64_t>(it, end);
+      uint64_t length = Read<uint64_t>(it, end);
+      UTIL_THROW_IF2(length > uint64_t(end - it), "Truncated translation cache file");
+      entry.printed.assign(it, length);
+      it += length;
+      loaded.push_back(std::move(entry));
+    }
+  }
+  catch(util::Exception&) {
+    LOG(info) << "Ignoring translation cache " << path << ": corrupt file";
+    return;
+  }
+
+  size_t entries = loaded.size();
+  for(auto& entry : loaded)
+    Add(std::move(entry));
+  LOG(info) << "Loaded " << entries << " cached translations from " << path;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "common/decoder_options.h"
+#include "common/sentence.h"
+
+// Maps preprocessed source sentences to their printed translations. The key
+// is the post-BPE word id sequence of every input tab together with a
+// fingerprint of the options that change the output, the size and age of the
+// files they name, and the version of the decoding options snapshot.
+// Entries are spread over independently locked shards, each evicting least
+// recently used entries once its share of the byte budget is used up.
+class TranslationCache {
+  public:
+    // With a `path`, entries are read from it, written back at destruction
+    // and, if `saveIntervalSeconds` is not 0, that often in between.
+    TranslationCache(size_t maxBytes, const std::string& path = "",
+                     size_t saveIntervalSeconds = 0);
+    ~TranslationCache();
+
+    // Returns true and fills `out` with the translation as it is printed for
+    // the sentence's line if the same input has been translated before.
+    bool Find(const Sentence& sentence, const DecoderOptions& options,
+              std::string& out);
+
+    // Stores `printed`, the output for the sentence's line.
+    void Insert(const Sentence& sentence, const DecoderOptions& options,
+                const std::string& printed);
+
+    size_t GetHits() const;
+    size_t GetMisses() const;
+    size_t GetBytes() const;
+
+    // Writes all entries to `path`, they are mapped back in on start-up.
+    void Save(const std::string& path) const;
+
+  private:
+    struct Entry {
+      uint64_t hash;
+      Words key;
+      size_t lineNo;
+      std::string printed;
+
+      size_t Bytes() const;
+    };
+
+    struct Shard {
+      std::mutex mutex;
+      std::list<Entry> lru;
+      std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+      size_t bytes = 0;
+    };
+
+    static Words MakeKey(const Sentence& sentence);
+    uint64_t Hash(const Words& key, size_t version) const;
+    Shard& GetShard(uint64_t hash);
+
+    void Add(Entry&& entry);
+    void Load(const std::string& path);
+
+    // text n-best lists start every line with the line number
+    static std::string Renumber(const std::string& printed,
+                                size_t from, size_t to);
+
+    const size_t maxBytes_;
+    const std::string path_;
+    uint64_t fingerprint_;
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+
+    std::atomic<size_t> hits_;
+    std::atomic<size_t> misses_;
+
+    std::mutex saverMutex_;
+    std::condition_variable saverStop_;
+    bool stopping_;
+    std::thread saver_;
+};
@@ -0,0 +1,111 @@
+#include "common/translation_task.h"
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <boost/thread/tss.hpp>
+
+#include "common/god.h"
+#include "common/logging.h"
+#include "common/metrics.h"
+#include "common/printer.h"
+#include "common/search.h"
+#include "common/synthetic_input.h"
+#include "common/timing.h"
+#include "common/trace.h"
+#include "common/translation_cache.h"
+
+namespace {
+
+// The Search object of the calling thread.
+#ifdef __APPLE__
+boost::thread_specific_ptr<Search> localSearch;
+#else
+thread_local std::unique_ptr<Search> localSearch;
+#endif
+
+Search& CreateSearch(size_t workerId) {
+  LOG(info) << "Created Search for worker " << workerId
+            << " on thread " << std::this_thread::get_id();
+  localSearch.reset(new Search(workerId));
+  return *localSearch;
+}
+
+size_t TotalThreads() {
+  size_t totalThreads = God::Get<size_t>("cpu-threads");
+#ifdef CUDA
+  totalThreads += God::Get<size_t>("gpu-threads")
+                  * God::Get<std::vector<size_t>>("devices").size();
+#endif
+  return totalThreads;
+}
+
+}
+
+History TranslationTask(SentencePtr sentence, const DecoderOptions& options) {
+  TraceSentence traced(sentence->GetLine());
+  TraceScope scope("TranslationTask", sentence->GetLine());
+
+  // Threads that were not initialized as workers number their Search objects
+  // in creation order. Thread pools can be created more than once (e.g. by
+  // the Python binding), so numbers wrap around.
+  static std::atomic<size_t> searchCounter(0);
+  Search* search = localSearch.get();
+  if(!search)
+    search = &CreateSearch(searchCounter++ % TotalThreads());
+
+  if(!Metrics::Enabled())
+    return search->Decode(*sentence, options);
+
+  Metrics::Clock::time_point start = Metrics::Clock::now();
+  History history = search->Decode(*sentence, options);
+  const Words& words = history.Top().first;
+  Metrics::AddSentence(sentence->GetWords().size() - 1,
+                       words.size() - (!words.empty() && words.back() == EOS),
+                       Metrics::Clock::now() - start);
+  return history;
+}
+
+std::function<void(size_t)> TranslationWorkerInit() {
+  std::vector<SentencePtr> warmUp;
+  std::mt19937 rng(1234);
+  for(size_t length : God::Get<std::vector<size_t>>("warm-up"))
+    warmUp.push_back(SyntheticInput::MakeSentence(warmUp.size(), length, rng));
+  DecoderOptionsPtr options = God::GetDecoderOptions();
+
+  return [warmUp, options](size_t workerId) {
+    Timing::Clock::time_point start = Timing::Clock::now();
+    Search& search = CreateSearch(workerId);
+    // straight to the search and paused, so the cache, metrics and timings
+    // only see real input
+    {
+      MetricsPause metricsPaused;
+      TimingPause timingPaused;
+      for(auto& sentence : warmUp)
+        search.Decode(*sentence, *options);
+    }
+
+    std::chrono::duration<double> elapsed = Timing::Clock::now() - start;
+    LOG(info) << "Worker " << workerId << " ready after " << elapsed.count() << "s"
+              << (warmUp.empty() ? "" : " including warm-up");
+  };
+}
+
+std::string PrintedTranslationTask(SentencePtr sentence) {
+  TraceSentence traced(sentence->GetLine());
+  DecoderOptionsPtr options = God::GetDecoderOptions();
+  TranslationCache* cache = God::GetTranslationCache();
+
+  std::string printed;
+  if(cache && cache->Find(*sentence, *options, printed))
+    return printed;
+
+  std::stringstream out;
+  Printer(TranslationTask(sentence, *options), sentence->GetLine(), out, *options);
+  printed = out.str();
+
+  if(cache)
+    cache->Insert(*sentence, *options, printed);
+  return printed;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "common/history.h"
+#include "common/sentence.h"
+
+// Decodes a prepared sentence with the Search object owned by the calling
+// thread, creating it on first use unless the thread is an initialized
+// worker.
+History TranslationTask(SentencePtr sentence, const DecoderOptions& options);
+
+// Worker initialization for a ThreadPool that runs translation tasks. Every
+// worker creates its Search object for its index as the worker id (the first
+// cpu-threads ids decode on the CPU) and translates random sentences of the
+// lengths given by option warm-up, so first requests do not pay for scorer
+// construction, cold weights and growing buffers.
+std::function<void(size_t)> TranslationWorkerInit();
+
+// Returns the translation as amun prints it for the sentence's line. Looks
+// the sentence up in the translation cache first if there is one.
+std::string PrintedTranslationTask(SentencePtr sentence);
@@ -6,6 +6,14 @@ void Trim(std::string& s) {
   boost::trim_if(s, boost::is_any_of(" \t\n"));
 }
 
+boost::string_view Trim(boost::string_view s) {
+  size_t begin = s.find_first_not_of(" \t\n");
+  if(begin == boost::string_view::npos)
+    return boost::string_view();
+  size_t end = s.find_last_not_of(" \t\n");
+  return s.substr(begin, end - begin + 1);
+}
+
 void Split(const std::string& line, std::vector<std::string>& pieces, const std::string del) {
   size_t begin = 0;
   size_t pos = 0;
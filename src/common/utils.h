@@ -1,10 +1,40 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <boost/algorithm/string.hpp>
+#include <boost/utility/string_view.hpp>
 
 void Trim(std::string& s);
 
+boost::string_view Trim(boost::string_view s);
+
 void Split(const std::string& line, std::vector<std::string>& pieces, const std::string del=" ");
 
 std::string Join(const std::vector<std::string>& words, const std::string del=" ");
+
+// FNV-1a of `length` bytes, continuing from `hash`. Binary vocabularies
+// and translation cache files depend on it, so it must not change.
+inline uint64_t Fnv1a(const char* data, size_t length,
+                      uint64_t hash = 0xcbf29ce484222325ULL) {
+  for(size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// Calls `f` with a view of every non-empty piece of `line` between `del`
+// characters, the same pieces Split() would copy out.
+template <class F>
+void ForEachPiece(boost::string_view line, char del, F f) {
+  size_t begin = 0;
+  while(begin < line.size()) {
+    size_t end = line.find(del, begin);
+    if(end == boost::string_view::npos)
+      end = line.size();
+    if(end > begin)
+      f(line.substr(begin, end - begin));
+    begin = end + 1;
+  }
+}
@@ -1,32 +1,158 @@
 #include "common/vocab.h"
 
-#include <sstream>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <yaml-cpp/yaml.h>
 
 #include "common/utils.h"
 #include "common/file_stream.h"
 #include "common/exception.h"
 
+namespace {
+
+const char MAGIC[8] = { 'A', 'M', 'U', 'N', 'V', 'O', 'C', '1' };
+
+inline size_t Align8(size_t bytes) {
+  return (bytes + 7) & ~size_t(7);
+}
+
+}
+
 Vocab::Vocab(const std::string& path) {
+  if(IsBinary(path)) {
+    file_.reset(new boost::iostreams::mapped_file_source(path));
+    Map(file_->data(), file_->size(), path);
+  }
+  else {
     YAML::Node vocab = YAML::Load(InputFileStream(path));
-    for(auto&& pair : vocab) {
-      auto str = pair.first.as<std::string>();
-      auto id = pair.second.as<Word>();
-      str2id_[str] = id;
-      if(id >= id2str_.size())
-        id2str_.resize(id + 1);
-      id2str_[id] = str;
-    }
-    UTIL_THROW_IF2(id2str_.empty(), "Empty vocabulary " << path);
-    id2str_[0] = "</s>";
+    std::vector<std::pair<std::string, Word>> words;
+    for(auto&& pair : vocab)
+      words.emplace_back(pair.first.as<std::string>(), pair.second.as<Word>());
+    UTIL_THROW_IF2(words.empty(), "Empty vocabulary " << path);
+    image_ = Compile(words);
+    Map(image_.data(), image_.size(), path);
+  }
+}
+
+bool Vocab::IsBinary(const std::string& path) {
+  char magic[sizeof(MAGIC)];
+  std::ifstream in(path, std::ios::binary);
+  return in.read(magic, sizeof(magic))
+    && std::memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+std::vector<char> Vocab::Compile(const std::vector<std::pair<std::string, Word>>& words) {
+  size_t buckets = 1;
+  while(buckets < 2 * words.size())
+    buckets <<= 1;
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.size = 0;
+  header.entries = words.size();
+  header.buckets = buckets;
+  header.poolBytes = 0;
+  for(auto& word : words) {
+    header.size = std::max<uint64_t>(header.size, word.second + 1);
+    header.poolBytes += word.first.size();
+  }
+
+  size_t entriesOffset = sizeof(Header);
+  size_t tableOffset = entriesOffset + header.entries * sizeof(Entry);
+  size_t poolOffset = Align8(tableOffset + buckets * sizeof(uint32_t));
+
+  std::vector<char> image(poolOffset + header.poolBytes, 0);
+  std::memcpy(image.data(), &header, sizeof(Header));
+  Entry* entries = reinterpret_cast<Entry*>(image.data() + entriesOffset);
+  uint32_t* table = reinterpret_cast<uint32_t*>(image.data() + tableOffset);
+  char* pool = image.data() + poolOffset;
+
+  uint64_t offset = 0;
+  for(size_t i = 0; i < words.size(); ++i) {
+    const std::string& str = words[i].first;
+    entries[i] = Entry{ offset, (uint32_t)str.size(), (uint32_t)words[i].second };
+    std::memcpy(pool + offset, str.data(), str.size());
+    offset += str.size();
+
+    // linear probing, slots hold entry index + 1, zero marks an empty slot
+    size_t slot = Fnv1a(str.data(), str.size()) & (buckets - 1);
+    while(table[slot] != 0)
+      slot = (slot + 1) & (buckets - 1);
+    table[slot] = i + 1;
+  }
+  return image;
+}
+
+void Vocab::Map(const char* data, size_t bytes, const std::string& path) {
+  UTIL_THROW_IF2(bytes < sizeof(Header), "Truncated vocabulary " << path);
+  data_ = data;
+  bytes_ = bytes;
+  header_ = reinterpret_cast<const Header*>(data);
+
+  // Every count is bounded by the file size first, so the offsets below
+  // cannot overflow.
+  const Header& header = *header_;
+  UTIL_THROW_IF2(header.entries == 0 || header.size == 0,
+                 "Empty vocabulary " << path);
+  UTIL_THROW_IF2(header.entries > bytes / sizeof(Entry)
+                 || header.buckets > bytes / sizeof(uint32_t)
+                 || header.poolBytes > bytes
+                 || header.size > uint64_t(UINT32_MAX) + 1,
+                 "Corrupt vocabulary " << path);
+  UTIL_THROW_IF2(header.buckets <= header.entries
+                 || (header.buckets & (header.buckets - 1)) != 0,
+                 "Corrupt vocabulary " << path << ": bad hash table size");
+
+  size_t entriesOffset = sizeof(Header);
+  size_t tableOffset = entriesOffset + header.entries * sizeof(Entry);
+  size_t poolOffset = Align8(tableOffset + header.buckets * sizeof(uint32_t));
+  UTIL_THROW_IF2(poolOffset + header.poolBytes != bytes,
+                 "Corrupt vocabulary " << path);
+
+  entries_ = reinterpret_cast<const Entry*>(data + entriesOffset);
+  table_ = reinterpret_cast<const uint32_t*>(data + tableOffset);
+  pool_ = data + poolOffset;
+
+  // Lookups stop at an empty slot and follow slots to entries.
+  size_t empty = 0;
+  for(size_t slot = 0; slot < header.buckets; ++slot) {
+    UTIL_THROW_IF2(table_[slot] > header.entries,
+                   "Corrupt vocabulary " << path << ": bad hash table slot");
+    empty += table_[slot] == 0;
+  }
+  UTIL_THROW_IF2(empty == 0, "Corrupt vocabulary " << path << ": full hash table");
+
+  // Words point into the pool, no string is copied.
+  id2str_.assign(header.size, boost::string_view());
+  for(size_t i = 0; i < header.entries; ++i) {
+    const Entry& entry = entries_[i];
+    UTIL_THROW_IF2(entry.offset > header.poolBytes
+                   || entry.length > header.poolBytes - entry.offset
+                   || entry.id >= header.size,
+                   "Corrupt vocabulary " << path << ": bad entry " << i);
+    id2str_[entry.id] = boost::string_view(pool_ + entry.offset, entry.length);
+  }
+  id2str_[0] = "</s>";
 }
 
-size_t Vocab::operator[](const std::string& word) const {
-    auto it = str2id_.find(word);
-    if(it != str2id_.end())
-        return it->second;
-    else
-        return 1;
+void Vocab::Save(const std::string& path) const {
+  std::ofstream out(path, std::ios::binary);
+  UTIL_THROW_IF2(!out, "Cannot write vocabulary to " << path);
+  out.write(data_, bytes_);
+}
+
+size_t Vocab::operator[](boost::string_view word) const {
+  size_t mask = header_->buckets - 1;
+  size_t slot = Fnv1a(word.data(), word.size()) & mask;
+  while(uint32_t index = table_[slot]) {
+    const Entry& entry = entries_[index - 1];
+    if(entry.length == word.size()
+       && std::memcmp(pool_ + entry.offset, word.data(), word.size()) == 0)
+      return entry.id;
+    slot = (slot + 1) & mask;
+  }
+  return 1;
 }
 
 Words Vocab::operator()(const std::vector<std::string>& lineTokens, bool addEOS) const {
@@ -39,23 +165,43 @@ Words Vocab::operator()(const std::vector<std::string>& lineTokens, bool addEOS)
 }
 
 Words Vocab::operator()(const std::string& line, bool addEOS) const {
-  std::vector<std::string> lineTokens;
-  Split(line, lineTokens, " ");
-  return (*this)(lineTokens, addEOS);
+  Words words;
+  (*this)(line, words, addEOS);
+  return words;
+}
+
+void Vocab::operator()(boost::string_view line, Words& words, bool addEOS) const {
+  ForEachPiece(line, ' ', [&](boost::string_view word) {
+    words.push_back((*this)[word]);
+  });
+  if(addEOS)
+    words.push_back(EOS);
 }
 
 std::vector<std::string> Vocab::operator()(const Words& sentence, bool ignoreEOS) const {
   std::vector<std::string> decoded;
   for(size_t i = 0; i < sentence.size(); ++i) {
     if(sentence[i] != EOS || !ignoreEOS) {
-      decoded.push_back((*this)[sentence[i]]);
+      decoded.push_back((*this)[sentence[i]].to_string());
     }
   }
   return decoded;
 }
 
+void Vocab::operator()(const Words& sentence, std::string& line, bool ignoreEOS) const {
+  bool first = true;
+  for(auto word : sentence) {
+    if(word != EOS || !ignoreEOS) {
+      if(!first)
+        line += ' ';
+      boost::string_view str = (*this)[word];
+      line.append(str.data(), str.size());
+      first = false;
+    }
+  }
+}
 
-const std::string& Vocab::operator[](size_t id) const {
+boost::string_view Vocab::operator[](size_t id) const {
   UTIL_THROW_IF2(id >= id2str_.size(), "Unknown word id: " << id);
   return id2str_[id];
 }
@@ -63,3 +209,7 @@ const std::string& Vocab::operator[](size_t id) const {
 size_t Vocab::size() const {
   return id2str_.size();
 }
+
+size_t Vocab::GetMemory() const {
+  return bytes_ + id2str_.capacity() * sizeof(boost::string_view);
+}
@@ -1,16 +1,24 @@
 #pragma once
 
-#include <map>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <boost/utility/string_view.hpp>
 
 #include "common/types.h"
 
+// Maps words to ids and back. A vocabulary is read either from a YAML/JSON
+// file or from the compiled binary format written by Save() (see
+// amun_vocab), which is detected by its header and memory-mapped. Both end
+// up in the same layout: a contiguous string pool indexed by an
+// open-addressing hash table, so lookups never allocate.
 class Vocab {
   public:
     Vocab(const std::string& path);
 
-    size_t operator[](const std::string& word) const;
+    size_t operator[](boost::string_view word) const;
 
     Words operator()(const std::vector<std::string>& lineTokens, bool addEOS = true) const;
 
@@ -18,11 +26,53 @@ class Vocab {
 
     std::vector<std::string> operator()(const Words& sentence, bool ignoreEOS = true) const;
 
-    const std::string& operator[](size_t id) const;
+    // Append to caller-owned buffers: the ids of the space separated tokens
+    // in `line`, or the words of `sentence` separated by spaces.
+    void operator()(boost::string_view line, Words& words, bool addEOS = true) const;
+
+    void operator()(const Words& sentence, std::string& line, bool ignoreEOS = true) const;
+
+    // Points into the vocabulary's string pool.
+    boost::string_view operator[](size_t id) const;
 
     size_t size() const;
 
+    // Bytes held by the table, whether read or mapped, and the id to word
+    // index.
+    size_t GetMemory() const;
+
+    // Writes the vocabulary in the binary format.
+    void Save(const std::string& path) const;
+
+    static bool IsBinary(const std::string& path);
+
   private:
-    std::map<std::string, size_t> str2id_;
-    std::vector<std::string> id2str_;
+    struct Header {
+      char magic[8];
+      uint64_t size;
+      uint64_t entries;
+      uint64_t buckets;
+      uint64_t poolBytes;
+    };
+
+    struct Entry {
+      uint64_t offset;
+      uint32_t length;
+      uint32_t id;
+    };
+
+    static std::vector<char> Compile(const std::vector<std::pair<std::string, Word>>& words);
+    void Map(const char* data, size_t bytes, const std::string& path);
+
+    std::unique_ptr<boost::iostreams::mapped_file_source> file_;
+    std::vector<char> image_;
+
+    const char* data_;
+    size_t bytes_;
+    const Header* header_;
+    const Entry* entries_;
+    const uint32_t* table_;
+    const char* pool_;
+
+    std::vector<boost::string_view> id2str_;
 };
@@ -0,0 +1,19 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "common/vocab.h"
+
+// Compiles a YAML/JSON vocabulary into the binary format that amun maps
+// directly into memory. The result can be used wherever a vocabulary path
+// is expected, amun recognizes it by its header.
+int main(int argc, char* argv[]) {
+  if(argc != 3) {
+    std::cerr << "Usage: " << argv[0] << " input.yml output.bin" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  Vocab vocab(argv[1]);
+  vocab.Save(argv[2]);
+  std::cerr << "Wrote " << vocab.size() << " words to " << argv[2] << std::endl;
+  return EXIT_SUCCESS;
+}
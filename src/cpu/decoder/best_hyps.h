@@ -20,12 +20,12 @@ struct ProbCompare {
   const float* data_;
 };
 
-void BestHyps(Beam& bestHyps,
+inline void BestHyps(Beam& bestHyps,
     const Beam& prevHyps,
 		const size_t beamSize,
 		const std::vector<ScorerPtr> &scorers,
 		const Words &filterIndices,
-    bool returnAlignment)
+    const DecoderOptions& options)
 {
   using namespace mblas;
 
@@ -35,7 +35,7 @@ void BestHyps(Beam& bestHyps,
 
   mblas::ArrayMatrix Costs(Probs.rows(), 1);
   for (size_t i = 0; i < prevHyps.size(); ++i) {
-    Costs.data()[i] = prevHyps[i]->GetCost();
+    Costs(i, 0) = prevHyps[i]->GetCost();
   }
 
   Probs *= weights[scorers[0]->GetName()];
@@ -47,16 +47,21 @@ void BestHyps(Beam& bestHyps,
 	  Probs += weights[scorers[i]->GetName()] * currProb;
   }
 
-  size_t size = Probs.rows() * Probs.columns(); // Probs.size();
-  std::vector<size_t> keys(size);
-  for (size_t i = 0; i < keys.size(); ++i) {
-    keys[i] = i;
+  // keys are offsets into the padded rows of Probs, the scores of all
+  // scorers have the same shape and therefore the same row spacing
+  const size_t cols = Probs.columns();
+  const size_t spacing = Probs.spacing();
+  std::vector<size_t> keys(Probs.rows() * cols);
+  for (size_t i = 0; i < Probs.rows(); ++i) {
+    for (size_t j = 0; j < cols; ++j) {
+      keys[i * cols + j] = i * spacing + j;
+    }
   }
 
   std::vector<size_t> bestKeys(beamSize);
   std::vector<float> bestCosts(beamSize);
 
-  if (!God::Get<bool>("allow-unk")) {
+  if (!options.allowUnk) {
     blaze::column(Probs, UNK) = std::numeric_limits<float>::lowest();
   }
 
@@ -69,33 +74,31 @@ void BestHyps(Beam& bestHyps,
   }
 
   std::vector<std::vector<float>> breakDowns;
-  bool doBreakdown = God::Get<bool>("n-best");
+  bool doBreakdown = options.nBest;
   if (doBreakdown) {
     breakDowns.push_back(bestCosts);
     for (auto& scorer : scorers) {
       std::vector<float> modelCosts(beamSize);
       mblas::ArrayMatrix &currProb = static_cast<mblas::ArrayMatrix&>(scorer->GetProbs());
 
-      auto it = boost::make_permutation_iterator(currProb.begin(), keys.begin());
+      auto it = boost::make_permutation_iterator(currProb.data(), keys.begin());
       std::copy(it, it + beamSize, modelCosts.begin());
       breakDowns.push_back(modelCosts);
     }
   }
 
-  bool filter = God::Get<std::vector<std::string>>("softmax-filter").size();
-
   for (size_t i = 0; i < beamSize; i++) {
-    size_t wordIndex = bestKeys[i] % Probs.columns();
+    size_t wordIndex = bestKeys[i] % spacing;
 
-    if (filter) {
+    if (options.softmaxFilter) {
       wordIndex = filterIndices[wordIndex];
     }
 
-    size_t hypIndex  = bestKeys[i] / Probs.columns();
+    size_t hypIndex  = bestKeys[i] / spacing;
     float cost = bestCosts[i];
 
     HypothesisPtr hyp;
-    if (returnAlignment) {
+    if (options.returnAlignment) {
       std::vector<SoftAlignmentPtr> alignments;
       for (auto& scorer : scorers) {
         if (CPU::EncoderDecoder* encdec = dynamic_cast<CPU::EncoderDecoder*>(scorer.get())) {
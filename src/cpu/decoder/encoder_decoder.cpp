@@ -9,6 +9,7 @@
 #include "cpu/dl4mt/dl4mt.h"
 
 #include "common/god.h"
+#include "common/huge_pages.h"
 #include "common/loader.h"
 #include "common/scorer.h"
 #include "common/sentence.h"
@@ -86,18 +87,22 @@ void EncoderDecoder::SetSource(const Sentence& source) {
 void EncoderDecoder::AssembleBeamState(const State& in,
                                        const Beam& beam,
                                        State& out) {
-  std::vector<size_t> beamWords;
-  std::vector<size_t> beamStateIds;
-  for(auto h : beam) {
-      beamWords.push_back(h->GetWord());
-      beamStateIds.push_back(h->GetPrevStateIndex());
-  }
+  BeamOrder order;
+  order.Reset(beam);
+  AssembleBeamState(in, beam, order, out);
+}
 
+void EncoderDecoder::AssembleBeamState(const State& in,
+                                       const Beam& beam,
+                                       const BeamOrder& order,
+                                       State& out) {
   const EDState& edIn = in.get<EDState>();
   EDState& edOut = out.get<EDState>();
 
-  edOut.GetStates() = mblas::Assemble<mblas::byRow, mblas::Matrix>(edIn.GetStates(), beamStateIds);
-  decoder_->Lookup(edOut.GetEmbeddings(), beamWords);
+  // into the storage out already has, which is a different state than in,
+  // so once the beam has been at its widest no step allocates
+  mblas::AssembleRows(edOut.GetStates(), edIn.GetStates(), order.prevStates);
+  decoder_->Lookup(edOut.GetEmbeddings(), order.words);
 }
 
 void EncoderDecoder::GetAttention(mblas::Matrix& Attention) {
@@ -128,6 +133,12 @@ BaseMatrix& EncoderDecoder::GetProbs() {
   return decoder_->GetProbs();
 }
 
+void EncoderDecoder::GetMemory(MemoryUsage& usage) const {
+  encoder_->GetMemory(usage);
+  decoder_->GetMemory(usage);
+  usage["scorer.temporaries"] += mblas::Bytes(SourceContext_);
+}
+
 
 ////////////////////////////////////////////////
 EncoderDecoderLoader::EncoderDecoderLoader(const std::string name,
@@ -139,6 +150,22 @@ void EncoderDecoderLoader::Load() {
 
   LOG(info) << "Loading model " << path;
   weights_.emplace_back(new Weights(path, 0));
+
+  // chooses and logs the kernels for this CPU before decoding starts
+  mblas::Kernels::Get();
+
+  if(HugePages::Enabled()) {
+    size_t advised = 0;
+    weights_.back()->ForEachMatrix([&advised](const auto& m) {
+      advised += mblas::AdviseHugePages(m);
+    });
+    HugePages::Log("weights." + name_, advised, weights_.back()->GetMemory());
+  }
+
+  memory_.Reset([this](MemoryUsage& usage) {
+    for(auto& weights : weights_)
+      usage["weights." + name_] += weights->GetMemory();
+  });
 }
 
 ScorerPtr EncoderDecoderLoader::NewScorer(const size_t) {
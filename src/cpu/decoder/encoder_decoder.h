@@ -63,6 +63,11 @@ class EncoderDecoder : public Scorer {
                                    const Beam& beam,
                                    State& out);
 
+    virtual void AssembleBeamState(const State& in,
+                                   const Beam& beam,
+                                   const BeamOrder& order,
+                                   State& out);
+
     void GetAttention(mblas::Matrix& Attention);
     mblas::Matrix& GetAttention();
 
@@ -72,6 +77,8 @@ class EncoderDecoder : public Scorer {
 
     void Filter(const std::vector<size_t>& filterIds);
 
+    void GetMemory(MemoryUsage& usage) const;
+
     CPU::Encoder& GetEncoder();
 
     CPU::Decoder& GetDecoder();
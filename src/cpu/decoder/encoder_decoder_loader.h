@@ -7,6 +7,7 @@
 #include "common/scorer.h"
 #include "common/loader.h"
 #include "common/logging.h"
+#include "common/memory_report.h"
 #include "common/base_best_hyps.h"
 
 namespace CPU {
@@ -25,6 +26,7 @@ class EncoderDecoderLoader : public Loader {
 
   private:
     std::vector<std::unique_ptr<Weights>> weights_;
+    MemorySource memory_;
 };
 
 } // namespace CPU
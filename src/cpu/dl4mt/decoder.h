@@ -4,11 +4,14 @@
 #include "model.h"
 #include "gru.h"
 #include "common/god.h"
+#include "common/timing.h"
 
 namespace CPU {
 
 class Decoder {
-  private:
+  public:
+    // The components of a decoder step, public so they can be benchmarked
+    // in isolation.
     template <class Weights>
     class Embeddings {
       public:
@@ -17,12 +20,11 @@ class Decoder {
         {}
 
         void Lookup(mblas::Matrix& Rows, const std::vector<size_t>& ids) {
-          using namespace mblas;
-          std::vector<size_t> tids = ids;
-          for(auto&& id : tids)
-            if(id >= w_.E_.rows())
-              id = 1;
-          Rows = Assemble<byRow, Matrix>(w_.E_, tids);
+          Rows.resize(ids.size(), w_.E_.columns(), false);
+          for(size_t i = 0; i < ids.size(); ++i) {
+            size_t id = ids[i] < w_.E_.rows() ? ids[i] : 1;
+            blaze::row(Rows, i) = blaze::row(w_.E_, id);
+          }
         }
 
         size_t GetCols() {
@@ -56,7 +58,7 @@ class Decoder {
           Temp2_ = 0.0f;
           AddBiasVector<byRow>(Temp2_, Temp1_);
 
-          State = Temp2_ * w_.Wi_;
+          Prod(State, Temp2_, w_.Wi_, "decoder.init");
           AddBiasVector<byRow>(State, w_.Bi_);
 
           State = blaze::forEach(State, Tanh());
@@ -68,6 +70,11 @@ class Decoder {
           gru_.GetNextState(NextState, State, Context);
         }
 
+        void GetMemory(MemoryUsage& usage) const {
+          gru_.GetMemory(usage);
+          usage["scorer.temporaries"] += mblas::Bytes(Temp1_) + mblas::Bytes(Temp2_);
+        }
+
       private:
         const Weights1& w_;
         const GRU<Weights2> gru_;
@@ -89,6 +96,10 @@ class Decoder {
           gru_.GetNextState(NextState, State, Context);
         }
 
+        void GetMemory(MemoryUsage& usage) const {
+          gru_.GetMemory(usage);
+        }
+
       private:
         const GRU<Weights> gru_;
     };
@@ -105,7 +116,7 @@ class Decoder {
 
         void Init(const mblas::Matrix& SourceContext) {
           using namespace mblas;
-          SCU_ = SourceContext * w_.U_;
+          Prod(SCU_, SourceContext, w_.U_, "attention.source");
           AddBiasVector<byRow>(SCU_, w_.B_);
         }
 
@@ -114,7 +125,7 @@ class Decoder {
                                      const mblas::Matrix& SourceContext) {
           using namespace mblas;
 
-          Temp2_ = HiddenState * w_.W_;
+          Prod(Temp2_, HiddenState, w_.W_, "attention.hidden");
 
           // For batching: create an A across different sentences,
           // maybe by mapping and looping. In the and join different
@@ -123,7 +134,7 @@ class Decoder {
           Temp1_ = Broadcast<Matrix>(Tanh(), SCU_, Temp2_);
 
           A_.resize(Temp1_.rows(), 1);
-          blaze::column(A_, 0) = Temp1_ * V_;
+          Prod(blaze::column(A_, 0), Temp1_, V_, "attention.score");
           size_t words = SourceContext.rows();
           // batch size, for batching, divide by numer of sentences
           size_t batchSize = HiddenState.rows();
@@ -133,7 +144,7 @@ class Decoder {
           blaze::forEach(A_, [=](float x) { return x + bias; });
 
           mblas::Softmax(A_);
-          AlignedSourceContext = A_ * SourceContext;
+          Prod(AlignedSourceContext, A_, SourceContext, "attention.context");
         }
 
         void GetAttention(mblas::Matrix& Attention) {
@@ -144,6 +155,12 @@ class Decoder {
           return A_;
         }
 
+        void GetMemory(MemoryUsage& usage) const {
+          using mblas::Bytes;
+          usage["scorer.temporaries"] += Bytes(SCU_) + Bytes(Temp1_) + Bytes(Temp2_)
+                                         + Bytes(A_) + Bytes(V_);
+        }
+
       private:
         const Weights& w_;
 
@@ -169,21 +186,21 @@ class Decoder {
                   const mblas::Matrix& AlignedSourceContext) {
           using namespace mblas;
 
-          T1_ = State * w_.W1_;
-          T2_ = Embedding * w_.W2_;
-          T3_ = AlignedSourceContext * w_.W3_;
+          Prod(T1_, State, w_.W1_, "softmax.state");
+          Prod(T2_, Embedding, w_.W2_, "softmax.embedding");
+          Prod(T3_, AlignedSourceContext, w_.W3_, "softmax.context");
 
           AddBiasVector<byRow>(T1_, w_.B1_);
           AddBiasVector<byRow>(T2_, w_.B2_);
           AddBiasVector<byRow>(T3_, w_.B3_);
 
-          auto t = blaze::forEach(T1_ + T2_ + T3_, Tanh());
+          T1_ = blaze::forEach(T1_ + T2_ + T3_, Tanh());
 
           if(!filtered_) {
-            Probs_ = t * w_.W4_;
+            IndexedProd(Probs_, T1_, w_.W4_, std::vector<size_t>(), "softmax.output");
             AddBiasVector<byRow>(Probs_, w_.B4_);
           } else {
-            Probs_ = t * FilteredW4_;
+            IndexedProd(Probs_, T1_, w_.W4_, filterIds_, "softmax.output_filtered");
             AddBiasVector<byRow>(Probs_, FilteredB4_);
           }
           mblas::Softmax(Probs_);
@@ -193,15 +210,23 @@ class Decoder {
         void Filter(const std::vector<size_t>& ids) {
           filtered_ = true;
           using namespace mblas;
-          FilteredW4_ = Assemble<byColumn, Matrix>(w_.W4_, ids);
+          filterIds_ = ids;
           FilteredB4_ = Assemble<byColumn, Matrix>(w_.B4_, ids);
         }
 
+        void GetMemory(MemoryUsage& usage) const {
+          using mblas::Bytes;
+          usage["scorer.filtered_output"] += filterIds_.capacity() * sizeof(size_t)
+                                             + Bytes(FilteredB4_);
+          usage["scorer.temporaries"] += Bytes(T1_) + Bytes(T2_) + Bytes(T3_) + Bytes(Probs_);
+        }
+
       private:
         const Weights& w_;
         bool filtered_;
 
-        mblas::Matrix FilteredW4_;
+        // the shortlist, whose rows of W4_ are read in place
+        std::vector<size_t> filterIds_;
         mblas::Matrix FilteredB4_;
 
         mblas::Matrix T1_;
@@ -223,10 +248,22 @@ class Decoder {
                   const mblas::Matrix& State,
                   const mblas::Matrix& Embeddings,
                   const mblas::Matrix& SourceContext) {
-      GetHiddenState(HiddenState_, State, Embeddings);
-      GetAlignedSourceContext(AlignedSourceContext_, HiddenState_, SourceContext);
-      GetNextState(NextState, HiddenState_, AlignedSourceContext_);
-      GetProbs(NextState, Embeddings, AlignedSourceContext_);
+      {
+        ScopedTimer timer(Stage::DecoderHidden);
+        GetHiddenState(HiddenState_, State, Embeddings);
+      }
+      {
+        ScopedTimer timer(Stage::DecoderAttention);
+        GetAlignedSourceContext(AlignedSourceContext_, HiddenState_, SourceContext);
+      }
+      {
+        ScopedTimer timer(Stage::DecoderSecondGRU);
+        GetNextState(NextState, HiddenState_, AlignedSourceContext_);
+      }
+      {
+        ScopedTimer timer(Stage::DecoderSoftmax);
+        GetProbs(NextState, Embeddings, AlignedSourceContext_);
+      }
     }
 
     BaseMatrix& GetProbs() {
@@ -267,6 +304,16 @@ class Decoder {
       return embeddings_.GetRows();
     }
 
+    void GetMemory(MemoryUsage& usage) const {
+      using mblas::Bytes;
+      usage["scorer.temporaries"] += Bytes(HiddenState_) + Bytes(AlignedSourceContext_)
+                                     + Bytes(Probs_);
+      rnn1_.GetMemory(usage);
+      rnn2_.GetMemory(usage);
+      attention_.GetMemory(usage);
+      softmax_.GetMemory(usage);
+    }
+
   private:
 
     void GetHiddenState(mblas::Matrix& HiddenState,
@@ -69,6 +69,11 @@ class Encoder {
         size_t GetStateLength() const {
           return gru_.GetStateLength();
         }
+
+        void GetMemory(MemoryUsage& usage) const {
+          gru_.GetMemory(usage);
+          usage["scorer.temporaries"] += mblas::Bytes(State_);
+        }
         
       private:
         // Model matrices
@@ -87,6 +92,11 @@ class Encoder {
     
     void GetContext(const std::vector<size_t>& words,
                     mblas::Matrix& context);
+
+    void GetMemory(MemoryUsage& usage) const {
+      forwardRnn_.GetMemory(usage);
+      backwardRnn_.GetMemory(usage);
+    }
     
   private:
     Embeddings<Weights::Embeddings> embeddings_;
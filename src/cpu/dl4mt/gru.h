@@ -1,5 +1,7 @@
 #pragma once
 #include "../mblas/matrix.h"
+#include "../mblas/packed_matrix.h"
+#include "common/memory_report.h"
 
 namespace CPU {
 
@@ -7,17 +9,13 @@ template <class Weights>
 class GRU {
   public:
     GRU(const Weights& model)
-    : w_(model) {
-      using namespace mblas;
-      WWx_ = Concat<byColumn, Matrix>(w_.W_, w_.Wx_);
-      UUx_ = Concat<byColumn, Matrix>(w_.U_, w_.Ux_);
-    }
+    : w_(model) {}
           
     void GetNextState(mblas::Matrix& NextState,
                       const mblas::Matrix& State,
                       const mblas::Matrix& Context) const {
-      RUH_ = Context * WWx_;
-      Temp_ = State * UUx_;
+      mblas::Prod(RUH_, Context, w_.WWx_, "gru.input");
+      mblas::Prod(Temp_, State, w_.UUx_, "gru.state");
       
       // @TODO: once broadcasting is available
       // implement this using blaze idioms
@@ -28,49 +26,34 @@ class GRU {
                         const mblas::Matrix& State) const {
       
       using namespace mblas;
-      using namespace blaze;
       
       const size_t rowNo = State.rows();
       const size_t colNo = State.columns();
       NextState.resize(rowNo, colNo);
       
-      for(int j = 0; j < rowNo; ++j) {
-        auto rowOut = row(NextState, j);
-        auto rowState = row(State, j);
-        
-        auto rowRuh = row(RUH_, j);
-        auto rowT   = row(Temp_, j);
-        
-        auto rowH   = subvector(rowRuh, 2 * colNo, colNo);
-        auto rowT2  = subvector(rowT, 2 * colNo, colNo);
-        
-        for(int i = 0; i < colNo; ++i) {
-          float ev1 = expapprox(-(rowRuh[i] + w_.B_(0, i) + rowT[i]));
-          float r = 1.0 / (1.0 + ev1);
-          
-          int k = i + colNo;
-          float ev2 = expapprox(-(rowRuh[k] + w_.B_(0, k) + rowT[k]));
-          float u = 1.0 / (1.0 + ev2);              
-    
-          float hv = rowH[i] + w_.Bx1_(0, i);
-          float t2v = rowT2[i] + w_.Bx2_(0, i);
-          hv = tanhapprox(hv + r * t2v);
-          rowOut[i] = (1.0 - u) * hv + u * rowState[i];
-        }
+      const Kernels& kernels = Kernels::Get();
+      for(size_t j = 0; j < rowNo; ++j) {
+        kernels.gru(AlignedRow(NextState, j), AlignedRow(State, j),
+                    AlignedRow(RUH_, j), AlignedRow(Temp_, j),
+                    AlignedRow(w_.B_, 0), AlignedRow(w_.Bx1_, 0), AlignedRow(w_.Bx2_, 0),
+                    colNo);
       }
       
     }
     
     size_t GetStateLength() const {
-      return w_.U_.rows();
+      return w_.UUx_.rows();
+    }
+
+    void GetMemory(MemoryUsage& usage) const {
+      using mblas::Bytes;
+      usage["scorer.temporaries"] += Bytes(RUH_) + Bytes(Temp_);
     }
 
     
   private:
     // Model matrices
-    const Weights& w_;    
-    mutable mblas::Matrix WWx_;
-    mutable mblas::Matrix UUx_;
+    const Weights& w_;
     
     // reused to avoid allocation
     mutable mblas::Matrix RUH_;
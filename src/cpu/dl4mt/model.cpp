@@ -9,13 +9,11 @@ Weights::Embeddings::Embeddings(const NpzConverter& model, const std::string &ke
 {}
 
 Weights::GRU::GRU(const NpzConverter& model, const std::vector<std::string> &keys)
-: W_(model[keys.at(0)]),
-  B_(model(keys.at(1), true)),
-  U_(model[keys.at(2)]),
-  Wx_(model[keys.at(3)]),
+: B_(model(keys.at(1), true)),
   Bx1_(model(keys.at(4), true)),
   Bx2_(Bx1_.rows(), Bx1_.columns()),
-  Ux_(model[keys.at(5)])
+  WWx_(mblas::Concat<mblas::byColumn, mblas::Matrix>(model[keys.at(0)], model[keys.at(3)])),
+  UUx_(mblas::Concat<mblas::byColumn, mblas::Matrix>(model[keys.at(2)], model[keys.at(5)]))
 {
     const_cast<mblas::Matrix&>(Bx2_) = 0.0f;
 }
@@ -28,13 +26,11 @@ Weights::DecInit::DecInit(const NpzConverter& model)
 {}
 
 Weights::DecGRU2::DecGRU2(const NpzConverter& model)
-: W_(model["decoder_Wc"]),
-  B_(model("decoder_b_nl", true)),
-  U_(model["decoder_U_nl"]),
-  Wx_(model["decoder_Wcx"]),
+: B_(model("decoder_b_nl", true)),
   Bx2_(model("decoder_bx_nl", true)),
   Bx1_(Bx2_.rows(), Bx2_.columns()),
-  Ux_(model["decoder_Ux_nl"])
+  WWx_(mblas::Concat<mblas::byColumn, mblas::Matrix>(model["decoder_Wc"], model["decoder_Wcx"])),
+  UUx_(mblas::Concat<mblas::byColumn, mblas::Matrix>(model["decoder_U_nl"], model["decoder_Ux_nl"]))
 {
     const_cast<mblas::Matrix&>(Bx1_) = 0.0f;
 }
@@ -54,7 +50,7 @@ Weights::DecSoftmax::DecSoftmax(const NpzConverter& model)
   B2_(model("ff_logit_prev_b", true)),
   W3_(model["ff_logit_ctx_W"]),
   B3_(model("ff_logit_ctx_b", true)),
-  W4_(model["ff_logit_W"]),
+  W4_(model("ff_logit_W", true)),
   B4_(model("ff_logit_b", true))
 {}
 
@@ -74,5 +70,11 @@ decSoftmax_(model)
 	//cerr << *this << endl;
 }
 
+size_t Weights::GetMemory() const {
+  size_t bytes = 0;
+  ForEachMatrix([&bytes](const auto& m) { bytes += mblas::Bytes(m); });
+  return bytes;
+}
+
 }
 
@@ -7,6 +7,7 @@
 #include "../npz_converter.h"
 
 #include "../mblas/matrix.h"
+#include "../mblas/packed_matrix.h"
 
 namespace CPU {
 
@@ -23,13 +24,12 @@ struct Weights {
   struct GRU {
 	GRU(const NpzConverter& model, const std::vector<std::string> &keys);
 
-    const mblas::Matrix W_;
     const mblas::Matrix B_;
-    const mblas::Matrix U_;
-    const mblas::Matrix Wx_;
     const mblas::Matrix Bx1_;
     const mblas::Matrix Bx2_;
-    const mblas::Matrix Ux_;
+    // [W | Wx] and [U | Ux], packed for the products with the beam.
+    const mblas::PackedMatrix WWx_;
+    const mblas::PackedMatrix UUx_;
   };
 
   //////////////////////////////////////////////////////////////////////////////
@@ -44,34 +44,34 @@ struct Weights {
   struct DecGRU2 {
     DecGRU2(const NpzConverter& model);
 
-    const mblas::Matrix W_;
     const mblas::Matrix B_;
-    const mblas::Matrix U_;
-    const mblas::Matrix Wx_;
     const mblas::Matrix Bx2_;
     const mblas::Matrix Bx1_;
-    const mblas::Matrix Ux_;
+    const mblas::PackedMatrix WWx_;
+    const mblas::PackedMatrix UUx_;
   };
 
   struct DecAttention {
     DecAttention(const NpzConverter& model);
 
     const mblas::Matrix V_;
-    const mblas::Matrix W_;
+    const mblas::PackedMatrix W_;
     const mblas::Matrix B_;
-    const mblas::Matrix U_;
+    const mblas::PackedMatrix U_;
     const mblas::Matrix C_;
   };
 
   struct DecSoftmax {
     DecSoftmax(const NpzConverter& model);
 
-    const mblas::Matrix W1_;
+    const mblas::PackedMatrix W1_;
     const mblas::Matrix B1_;
-    const mblas::Matrix W2_;
+    const mblas::PackedMatrix W2_;
     const mblas::Matrix B2_;
-    const mblas::Matrix W3_;
+    const mblas::PackedMatrix W3_;
     const mblas::Matrix B3_;
+    // Vocab-major, the transpose of ff_logit_W with a row per target word,
+    // so the rows of a shortlist are read in place by IndexedProd().
     const mblas::Matrix W4_;
     const mblas::Matrix B4_;
   };
@@ -88,6 +88,29 @@ struct Weights {
     return 0;
   }
 
+  // Bytes held by all matrices of the model.
+  size_t GetMemory() const;
+
+  // Calls `f` with every matrix of the model, plain or packed.
+  template <class F>
+  void ForEachMatrix(F f) const {
+    auto gru = [&f](const GRU& w) {
+      f(w.B_); f(w.Bx1_); f(w.Bx2_); f(w.WWx_); f(w.UUx_);
+    };
+    f(encEmbeddings_.E_);
+    f(decEmbeddings_.E_);
+    gru(encForwardGRU_);
+    gru(encBackwardGRU_);
+    f(decInit_.Wi_); f(decInit_.Bi_);
+    gru(decGru1_);
+    f(decGru2_.B_); f(decGru2_.Bx2_); f(decGru2_.Bx1_);
+    f(decGru2_.WWx_); f(decGru2_.UUx_);
+    f(decAttention_.V_); f(decAttention_.W_); f(decAttention_.B_);
+    f(decAttention_.U_); f(decAttention_.C_);
+    f(decSoftmax_.W1_); f(decSoftmax_.B1_); f(decSoftmax_.W2_); f(decSoftmax_.B2_);
+    f(decSoftmax_.W3_); f(decSoftmax_.B3_); f(decSoftmax_.W4_); f(decSoftmax_.B4_);
+  }
+
   const Embeddings encEmbeddings_;
   const Embeddings decEmbeddings_;
   const GRU encForwardGRU_;
@@ -107,25 +130,21 @@ inline std::ostream& operator<<(std::ostream &out, const Weights::Embeddings &ob
 
 inline std::ostream& operator<<(std::ostream &out, const Weights::GRU &obj)
 {
-	out << "W_ \t" << obj.W_ << std::endl;
 	out << "B_ \t" << obj.B_ << std::endl;
-	out << "U_ \t" << obj.U_ << std::endl;
-	out << "Wx_ \t" << obj.Wx_ << std::endl;
 	out << "Bx1_ \t" << obj.Bx1_ << std::endl;
 	out << "Bx2_ \t" << obj.Bx2_ << std::endl;
-	out << "Ux_ \t" << obj.Ux_;
+	out << "WWx_ \t" << obj.WWx_ << std::endl;
+	out << "UUx_ \t" << obj.UUx_;
 	return out;
 }
 
 inline std::ostream& operator<<(std::ostream &out, const Weights::DecGRU2 &obj)
 {
-	out << "W_ \t" << obj.W_ << std::endl;
 	out << "B_ \t" << obj.B_ << std::endl;
-	out << "U_ \t" << obj.U_ << std::endl;
-	out << "Wx_ \t" << obj.Wx_ << std::endl;
 	out << "Bx1_ \t" << obj.Bx1_ << std::endl;
 	out << "Bx2_ \t" << obj.Bx2_ << std::endl;
-	out << "Ux_ \t" << obj.Ux_;
+	out << "WWx_ \t" << obj.WWx_ << std::endl;
+	out << "UUx_ \t" << obj.UUx_;
 	return out;
 }
 
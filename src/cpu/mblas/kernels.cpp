@@ -0,0 +1,118 @@
+#include "cpu/mblas/kernels.h"
+
+#include <sstream>
+#include <utility>
+
+#include "common/logging.h"
+#include "cpu/mblas/matrix.h"
+#include "cpu/mblas/packed_matrix.h"
+
+namespace CPU {
+
+namespace mblas {
+
+#if !defined(__AVX512F__)
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,avx512dq,avx512vl,avx2,fma")
+#define KERNELS_NAMESPACE avx512
+#define KERNELS_NAME "avx512"
+#define KERNELS_BLOCK_ROWS 12
+#define KERNELS_DOT_BYTES 64
+#define KERNELS_DOT_ROWS 6
+#define KERNELS_DOT_WORDS 4
+#include "cpu/mblas/kernels_impl.h"
+#undef KERNELS_DOT_WORDS
+#undef KERNELS_DOT_ROWS
+#undef KERNELS_DOT_BYTES
+#undef KERNELS_BLOCK_ROWS
+#undef KERNELS_NAME
+#undef KERNELS_NAMESPACE
+#pragma GCC pop_options
+#endif
+
+#if !defined(__AVX2__)
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+#define KERNELS_NAMESPACE avx2
+#define KERNELS_NAME "avx2"
+#define KERNELS_BLOCK_ROWS 6
+#define KERNELS_DOT_BYTES 32
+#define KERNELS_DOT_ROWS 4
+#define KERNELS_DOT_WORDS 3
+#include "cpu/mblas/kernels_impl.h"
+#undef KERNELS_DOT_WORDS
+#undef KERNELS_DOT_ROWS
+#undef KERNELS_DOT_BYTES
+#undef KERNELS_BLOCK_ROWS
+#undef KERNELS_NAME
+#undef KERNELS_NAMESPACE
+#pragma GCC pop_options
+#endif
+
+// Whatever the build targets with -march, e.g. everything up to AVX-512
+// with -march=native on such a CPU.
+#define KERNELS_NAMESPACE base
+#define KERNELS_NAME "base"
+#if defined(__AVX512F__)
+#define KERNELS_BLOCK_ROWS 12
+#define KERNELS_DOT_BYTES 64
+#define KERNELS_DOT_ROWS 6
+#define KERNELS_DOT_WORDS 4
+#elif defined(__AVX__)
+#define KERNELS_BLOCK_ROWS 6
+#define KERNELS_DOT_BYTES 32
+#define KERNELS_DOT_ROWS 4
+#define KERNELS_DOT_WORDS 3
+#else
+#define KERNELS_BLOCK_ROWS 6
+#define KERNELS_DOT_BYTES 16
+#define KERNELS_DOT_ROWS 4
+#define KERNELS_DOT_WORDS 3
+#endif
+#include "cpu/mblas/kernels_impl.h"
+#undef KERNELS_DOT_WORDS
+#undef KERNELS_DOT_ROWS
+#undef KERNELS_DOT_BYTES
+#undef KERNELS_BLOCK_ROWS
+#undef KERNELS_NAME
+#undef KERNELS_NAMESPACE
+
+namespace {
+
+const Kernels& Choose() {
+  __builtin_cpu_init();
+
+  std::stringstream compiled;
+#if !defined(__AVX512F__)
+  compiled << avx512::kernels.name << ", ";
+#endif
+#if !defined(__AVX2__)
+  compiled << avx2::kernels.name << ", ";
+#endif
+  compiled << base::kernels.name;
+
+  const Kernels* kernels = &base::kernels;
+#if !defined(__AVX2__)
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    kernels = &avx2::kernels;
+#endif
+#if !defined(__AVX512F__)
+  if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")
+     && __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl"))
+    kernels = &avx512::kernels;
+#endif
+
+  LOG(info) << "CPU kernels: " << kernels->name << " (compiled for " << compiled.str() << ")";
+  return *kernels;
+}
+
+}
+
+const Kernels& Kernels::Get() {
+  static const Kernels& kernels = Choose();
+  return kernels;
+}
+
+}
+
+}
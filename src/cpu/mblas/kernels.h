@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+
+namespace CPU {
+
+namespace mblas {
+
+class PackedMatrix;
+
+// The hot loops of the CPU decoder, compiled for several instruction sets
+// in one binary, so a build for an older -march still uses AVX2 or AVX-512
+// where the CPU has them. Only sets above the one the build targets are
+// compiled in addition to it. The arguments are plain pointers with row
+// strides, nothing the loops call is shared with code built for another set.
+struct Kernels {
+  // The instruction set, e.g. "avx2".
+  const char* name;
+
+  // C = A * B for `rows` rows of A and C, which are lda and ldc apart.
+  void (*packedProd)(float* C, size_t ldc, const float* A, size_t lda,
+                     size_t rows, const PackedMatrix& B);
+
+  // C = A * trans(B) for `rows` rows of A and C and the rows of B at ids,
+  // or the first n rows of B without ids. The rows of B have K floats and
+  // are ldb apart, e.g. an output layer stored with a row per word.
+  void (*indexedProd)(float* C, size_t ldc, const float* A, size_t lda, size_t rows,
+                      const float* B, size_t ldb, size_t K, const size_t* ids, size_t n);
+
+  // Softmax of a row in place.
+  void (*softmax)(float* row, size_t cols);
+
+  // The elementwise step of a GRU for one row of the next state, with the
+  // products for the gates in ruh and temp and the biases b, bx1 and bx2.
+  void (*gru)(float* out, const float* state, const float* ruh, const float* temp,
+              const float* b, const float* bx1, const float* bx2, size_t cols);
+
+  // The best kernels for this CPU, detected with CPUID on the first call,
+  // which logs the choice.
+  static const Kernels& Get();
+};
+
+}
+
+}
@@ -0,0 +1,233 @@
+// The kernels for one instruction set, included by kernels.cpp once per
+// set under a "#pragma GCC target", in the namespace KERNELS_NAMESPACE.
+// The pragma does not define macros like __AVX512F__ in C++, what depends
+// on the set comes in as KERNELS_ macros.
+// Everything here is defined in that namespace, so no function compiled
+// for one set is merged with the same function compiled for another.
+// Inline functions from other headers, like expapprox(), are compiled for
+// the base set and inlined into these.
+
+namespace KERNELS_NAMESPACE {
+
+// One panel of the result as vector registers, with the compiler's vector
+// extensions so the kernel is vectorized for the target instruction set.
+typedef float PanelRow __attribute__((vector_size(PackedMatrix::PanelWidth * sizeof(float))));
+
+// Row blocks that keep their accumulators, a panel and a broadcast in the
+// vector registers of the instruction set.
+const size_t BlockRows = KERNELS_BLOCK_ROWS;
+
+// Independent sums per row, enough to hide the latency of the additions
+// when there are few rows.
+template <size_t M>
+struct Chains {
+  static const size_t value = M >= 4 ? 1 : 4 / M;
+};
+
+// C [M x N] = A [M x K] * B for the M rows starting at A and C.
+template <size_t M>
+void Kernel(float* C, size_t ldc, const float* A, size_t lda, const PackedMatrix& B) {
+  const size_t S = Chains<M>::value;
+  const size_t W = PackedMatrix::PanelWidth;
+  const size_t K = B.rows();
+  const size_t N = B.columns();
+
+  for(size_t p = 0; p < B.Panels(); ++p) {
+    const float* b = B.Panel(p);
+
+    PanelRow acc[S][M];
+    for(size_t s = 0; s < S; ++s)
+      for(size_t i = 0; i < M; ++i)
+        acc[s][i] = PanelRow{};
+
+    size_t k = 0;
+    for(; k + S <= K; k += S, b += S * W) {
+      for(size_t s = 0; s < S; ++s) {
+        PanelRow panel;
+        __builtin_memcpy(&panel, b + s * W, sizeof(PanelRow));
+        for(size_t i = 0; i < M; ++i)
+          acc[s][i] += A[i * lda + k + s] * panel;
+      }
+    }
+    for(; k < K; ++k, b += W) {
+      PanelRow panel;
+      __builtin_memcpy(&panel, b, sizeof(PanelRow));
+      for(size_t i = 0; i < M; ++i)
+        acc[0][i] += A[i * lda + k] * panel;
+    }
+    for(size_t s = 1; s < S; ++s)
+      for(size_t i = 0; i < M; ++i)
+        acc[0][i] += acc[s][i];
+
+    size_t col = p * W;
+    size_t cols = N - col < W ? N - col : W;
+    for(size_t i = 0; i < M; ++i)
+      __builtin_memcpy(C + i * ldc + col, &acc[0][i], cols * sizeof(float));
+  }
+}
+
+typedef void (*KernelPtr)(float*, size_t, const float*, size_t, const PackedMatrix&);
+
+template <size_t... Rows>
+struct BlockKernels {
+  static KernelPtr Get(size_t rows) {
+    static const KernelPtr kernels[] = { Kernel<Rows>... };
+    return kernels[rows - 1];
+  }
+};
+
+template <size_t N, size_t... Rows>
+struct MakeKernels : MakeKernels<N - 1, N, Rows...> {};
+
+template <size_t... Rows>
+struct MakeKernels<0, Rows...> : BlockKernels<Rows...> {};
+
+void PackedProd(float* C, size_t ldc, const float* A, size_t lda,
+                size_t rows, const PackedMatrix& B) {
+  for(size_t i = 0; i < rows; i += BlockRows) {
+    size_t block = rows - i < BlockRows ? rows - i : BlockRows;
+    MakeKernels<BlockRows>::Get(block)(C + i * ldc, ldc, A + i * lda, lda, B);
+  }
+}
+
+// Vectors as wide as the registers of the instruction set for the dot
+// products of IndexedProd, and blocks of rows and words whose sums fit in
+// those registers.
+typedef float DotVector __attribute__((vector_size(KERNELS_DOT_BYTES)));
+const size_t DotWidth = KERNELS_DOT_BYTES / sizeof(float);
+const size_t DotRows = KERNELS_DOT_ROWS;
+const size_t DotWords = KERNELS_DOT_WORDS;
+
+// Sum of the floats of a vector of Bytes bytes, added in halves so the
+// compiler uses vector additions instead of one addition after another.
+template <size_t Bytes>
+struct Halves {
+  typedef float Vector __attribute__((vector_size(Bytes)));
+
+  static float Sum(Vector v) {
+    typename Halves<Bytes / 2>::Vector low, high;
+    __builtin_memcpy(&low, &v, Bytes / 2);
+    __builtin_memcpy(&high, reinterpret_cast<const char*>(&v) + Bytes / 2, Bytes / 2);
+    return Halves<Bytes / 2>::Sum(low + high);
+  }
+};
+
+template <>
+struct Halves<2 * sizeof(float)> {
+  typedef float Vector __attribute__((vector_size(2 * sizeof(float))));
+
+  static float Sum(Vector v) {
+    return v[0] + v[1];
+  }
+};
+
+inline float Sum(DotVector v) {
+  return Halves<sizeof(DotVector)>::Sum(v);
+}
+
+// C [M x N] = A [M x K] * trans(B) for the M rows starting at A and C and
+// the N rows of B at b.
+template <size_t M, size_t N>
+void DotKernel(float* C, size_t ldc, const float* A, size_t lda,
+               const float* const* b, size_t K) {
+  DotVector acc[M][N];
+  for(size_t i = 0; i < M; ++i)
+    for(size_t j = 0; j < N; ++j)
+      acc[i][j] = DotVector{};
+
+  size_t k = 0;
+  for(; k + DotWidth <= K; k += DotWidth) {
+    DotVector bv[N];
+    for(size_t j = 0; j < N; ++j)
+      __builtin_memcpy(&bv[j], b[j] + k, sizeof(DotVector));
+    for(size_t i = 0; i < M; ++i) {
+      DotVector a;
+      __builtin_memcpy(&a, A + i * lda + k, sizeof(DotVector));
+      for(size_t j = 0; j < N; ++j)
+        acc[i][j] += a * bv[j];
+    }
+  }
+
+  for(size_t i = 0; i < M; ++i) {
+    for(size_t j = 0; j < N; ++j) {
+      float sum = Sum(acc[i][j]);
+      for(size_t t = k; t < K; ++t)
+        sum += A[i * lda + t] * b[j][t];
+      C[i * ldc + j] = sum;
+    }
+  }
+}
+
+typedef void (*DotKernelPtr)(float*, size_t, const float*, size_t, const float* const*, size_t);
+
+template <size_t N, size_t... I>
+DotKernelPtr GetDotKernel(size_t rows, std::index_sequence<I...>) {
+  static const DotKernelPtr kernels[] = { DotKernel<I + 1, N>... };
+  return kernels[rows - 1];
+}
+
+void IndexedProd(float* C, size_t ldc, const float* A, size_t lda, size_t rows,
+                 const float* B, size_t ldb, size_t K, const size_t* ids, size_t n) {
+  const float* b[DotWords];
+  size_t j = 0;
+  // words outside, so B is read once however many rows there are
+  for(; j + DotWords <= n; j += DotWords) {
+    for(size_t w = 0; w < DotWords; ++w)
+      b[w] = B + (ids ? ids[j + w] : j + w) * ldb;
+    for(size_t i = 0; i < rows; i += DotRows) {
+      size_t block = rows - i < DotRows ? rows - i : DotRows;
+      GetDotKernel<DotWords>(block, std::make_index_sequence<DotRows>())
+        (C + i * ldc + j, ldc, A + i * lda, lda, b, K);
+    }
+  }
+  for(; j < n; ++j) {
+    b[0] = B + (ids ? ids[j] : j) * ldb;
+    for(size_t i = 0; i < rows; i += DotRows) {
+      size_t block = rows - i < DotRows ? rows - i : DotRows;
+      GetDotKernel<1>(block, std::make_index_sequence<DotRows>())
+        (C + i * ldc + j, ldc, A + i * lda, lda, b, K);
+    }
+  }
+}
+
+void Softmax(float* row, size_t cols) {
+  row = static_cast<float*>(__builtin_assume_aligned(row, blaze::AlignmentOf<float>::value));
+  float sum = 0;
+  for(size_t i = 0; i < cols; ++i) {
+    row[i] = expapprox(row[i]);
+    sum += row[i];
+  }
+  for(size_t i = 0; i < cols; ++i) {
+    row[i] /= sum;
+  }
+}
+
+void GRU(float* out, const float* state, const float* ruh, const float* temp,
+         const float* b, const float* bx1, const float* bx2, size_t cols) {
+  const size_t alignment = blaze::AlignmentOf<float>::value;
+  out   = static_cast<float*>(__builtin_assume_aligned(out, alignment));
+  state = static_cast<const float*>(__builtin_assume_aligned(state, alignment));
+  ruh   = static_cast<const float*>(__builtin_assume_aligned(ruh, alignment));
+  temp  = static_cast<const float*>(__builtin_assume_aligned(temp, alignment));
+
+  const float* h  = ruh + 2 * cols;
+  const float* t2 = temp + 2 * cols;
+
+  for(size_t i = 0; i < cols; ++i) {
+    float ev1 = expapprox(-(ruh[i] + b[i] + temp[i]));
+    float r = 1.0 / (1.0 + ev1);
+
+    size_t k = i + cols;
+    float ev2 = expapprox(-(ruh[k] + b[k] + temp[k]));
+    float u = 1.0 / (1.0 + ev2);
+
+    float hv = h[i] + bx1[i];
+    float t2v = t2[i] + bx2[i];
+    hv = tanhapprox(hv + r * t2v);
+    out[i] = (1.0 - u) * hv + u * state[i];
+  }
+}
+
+const Kernels kernels = { KERNELS_NAME, PackedProd, IndexedProd, Softmax, GRU };
+
+}
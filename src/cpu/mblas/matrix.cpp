@@ -17,6 +17,19 @@ namespace CPU {
 
 namespace mblas {
 
+void IndexedProd(Matrix& Out, const Matrix& A, const Matrix& B,
+                 const std::vector<size_t>& ids) {
+  UTIL_THROW_IF2(A.columns() != B.columns(),
+                 "Cannot multiply " << A.rows() << "x" << A.columns()
+                 << " by the rows of " << B.rows() << "x" << B.columns());
+
+  const size_t N = ids.empty() ? B.rows() : ids.size();
+  Out.resize(A.rows(), N, false);
+  Kernels::Get().indexedProd(Out.data(), Out.spacing(), A.data(), A.spacing(), A.rows(),
+                             B.data(), B.spacing(), B.columns(),
+                             ids.empty() ? nullptr : ids.data(), N);
+}
+
 }
 }
 
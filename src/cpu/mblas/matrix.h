@@ -1,13 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <vector>
 #include <sstream>
 
 #include <blaze/Math.h>
+#include <blaze/util/AlignedAllocator.h>
 #include "phoenix_functions.h"
 #include "common/base_matrix.h"
+#include "common/gemm_profile.h"
+#include "common/huge_pages.h"
+#include "cpu/mblas/kernels.h"
 
 namespace CPU {
 
@@ -17,33 +22,42 @@ typedef blaze::DynamicMatrix<float, blaze::rowMajor> Matrix;
 typedef blaze::DynamicVector<float, blaze::rowVector> Vector;
 typedef blaze::DynamicVector<float, blaze::columnVector> ColumnVector;
 
+// A matrix on storage it owns, laid out like a DynamicMatrix: aligned for
+// SIMD and with every row padded with zeros to a multiple of the SIMD width,
+// so blaze takes its aligned code paths. The padding is not part of Rows()
+// and Cols(), element (i, j) is at data()[i * spacing() + j].
 template <typename T, bool SO = blaze::rowMajor>
-class BlazeMatrix : public BaseMatrix, public blaze::CustomMatrix<T, blaze::unaligned,
-                                             blaze::unpadded,
+class BlazeMatrix : public BaseMatrix, public blaze::CustomMatrix<T, blaze::aligned,
+                                             blaze::padded,
                                              blaze::rowMajor> {
   public:
     typedef T value_type;
-    typedef typename std::vector<value_type>::iterator iterator;
-    typedef typename std::vector<value_type>::const_iterator const_iterator;
     typedef blaze::CustomMatrix<value_type,
-                                blaze::unaligned,
-                                blaze::unpadded,
+                                blaze::aligned,
+                                blaze::padded,
                                 SO> BlazeBase;
 
     BlazeMatrix() {}
 
-    BlazeMatrix(size_t rows, size_t columns, value_type val = 0)
-     : data_(rows * columns, val) {
-       BlazeBase temp(data_.data(), rows, columns);
-       std::swap(temp, *(BlazeBase*)this);
+    BlazeMatrix(size_t rows, size_t columns, value_type val = 0) {
+      Resize(rows, columns);
+      *(BlazeBase*)this = val;
     }
 
     template <class MT>
-    BlazeMatrix(const MT& rhs)
-     : data_(rhs.rows() * rhs.columns()) {
-       BlazeBase temp(data_.data(), rhs.rows(), rhs.columns());
-       temp = rhs;
-       std::swap(temp, *(BlazeBase*)this);
+    BlazeMatrix(const MT& rhs) {
+      Resize(rhs.rows(), rhs.columns());
+      *(BlazeBase*)this = rhs;
+    }
+
+    BlazeMatrix(const BlazeMatrix<T, SO>& rhs)
+     : BaseMatrix(rhs), data_(rhs.data_) {
+      Bind(rhs.rows(), rhs.columns());
+    }
+
+    BlazeMatrix(BlazeMatrix<T, SO>&& rhs)
+     : BaseMatrix(rhs) {
+      swap(rhs);
     }
 
     virtual size_t Rows() const
@@ -56,10 +70,15 @@ class BlazeMatrix : public BaseMatrix, public blaze::CustomMatrix<T, blaze::unal
     	return BlazeBase::columns();
     }
 
+    // Keeps the storage if it is large enough, the contents are undefined
+    // afterwards but the padding is zero.
     virtual void Resize(size_t rows, size_t columns) {
-       data_.resize(rows * columns);
-       BlazeBase temp(data_.data(), rows, columns);
-       std::swap(temp, *(BlazeBase*)this);
+      const size_t spacing = Spacing(columns);
+      data_.resize(rows * spacing);
+      for(size_t i = 0; i < rows; ++i)
+        std::fill(data_.begin() + i * spacing + columns,
+                  data_.begin() + (i + 1) * spacing, value_type());
+      Bind(rows, columns);
     }
 
     virtual std::string Debug() const
@@ -74,12 +93,23 @@ class BlazeMatrix : public BaseMatrix, public blaze::CustomMatrix<T, blaze::unal
       return *this;
     }
 
+    BlazeMatrix<T, SO>& operator=(const BlazeMatrix<T, SO>& rhs) {
+      if(this != &rhs) {
+        data_ = rhs.data_;
+        Bind(rhs.rows(), rhs.columns());
+      }
+      return *this;
+    }
+
+    BlazeMatrix<T, SO>& operator=(BlazeMatrix<T, SO>&& rhs) {
+      swap(rhs);
+      return *this;
+    }
+
     template <class MT>
     BlazeMatrix<T, SO>& operator=(const MT& rhs) {
       Resize(rhs.rows(), rhs.columns());
-      BlazeBase temp(data_.data(), rhs.rows(), rhs.columns());
-      temp = rhs;
-      std::swap(temp, *(BlazeBase*)this);
+      *(BlazeBase*)this = rhs;
       return *this;
     }
 
@@ -87,33 +117,27 @@ class BlazeMatrix : public BaseMatrix, public blaze::CustomMatrix<T, blaze::unal
       return *(BlazeBase*)this;
     }
 
-    iterator begin() {
-      return data_.begin();
-    }
-
-    iterator end() {
-      return data_.end();
-    }
-
-    const_iterator begin() const{
-      return data_.begin();
-    }
-
-    const_iterator end() const {
-      return data_.end();
-    }
-
-    size_t size() const {
-      return data_.size();
-    }
-
     void swap(BlazeMatrix<T, SO>& rhs) {
       std::swap(data_, rhs.data_);
       std::swap(static_cast<BlazeBase&>(*this), static_cast<BlazeBase&>(rhs));
     }
 
   private:
-    std::vector<value_type> data_;
+    static size_t Spacing(size_t columns) {
+      return blaze::nextMultiple<size_t>(columns, blaze::SIMDTrait<value_type>::size);
+    }
+
+    void Bind(size_t rows, size_t columns) {
+      if(data_.empty()) {
+        BlazeBase empty;
+        std::swap(empty, *(BlazeBase*)this);
+        return;
+      }
+      BlazeBase temp(data_.data(), rows, columns, Spacing(columns));
+      std::swap(temp, *(BlazeBase*)this);
+    }
+
+    std::vector<value_type, blaze::AlignedAllocator<value_type>> data_;
 };
 
 ////////////////////////////////////////////////////////////////////////
@@ -134,9 +158,28 @@ class ArrayMatrix : public BlazeMatrix<float, blaze::rowMajor>
       : Parent(rhs)
     {}
 
+    template <class MT>
+    ArrayMatrix& operator=(const MT& rhs) {
+      Parent::operator=(rhs);
+      return *this;
+    }
+
 };
 
 ////////////////////////////////////////////////////////////////////////
+// Bytes allocated for the elements of a matrix or vector.
+template <class M>
+size_t Bytes(const M& m) {
+  return m.capacity() * sizeof(float);
+}
+
+// Backs the elements of a large matrix with huge pages if enabled, returns
+// the bytes covered.
+template <class M>
+size_t AdviseHugePages(const M& m) {
+  return HugePages::Advise(m.data(), Bytes(m));
+}
+
 template <class M>
 std::string Debug(const M& m)
 {
@@ -264,20 +307,81 @@ MT Assemble(const MT1& in,
   return std::move(out);
 }
 
+// The rows of In at indeces into the storage of Out, which is only
+// reallocated if it has to grow. Out must not be In.
+template <class MT, class MT1>
+void AssembleRows(MT& Out, const MT1& In,
+                  const std::vector<size_t>& indeces) {
+  Out.resize(indeces.size(), In.columns(), false);
+  for(size_t i = 0; i < indeces.size(); ++i)
+    blaze::row(Out, i) = blaze::row(In, indeces[i]);
+}
+
+// Out = A * B. With a GEMM profile the shape and time of the product are
+// recorded under `site`, a string literal naming the call site.
+template <class MT, class MT1, class MT2>
+void Prod(MT&& Out, const MT1& A, const MT2& B, const char* site) {
+  if(!GemmProfile::Enabled()) {
+    Out = A * B;
+    return;
+  }
+  GemmProfile::Clock::time_point start = GemmProfile::Clock::now();
+  Out = A * B;
+  GemmProfile::Add(site, A.rows(), B.columns(), A.columns(),
+                   GemmProfile::Clock::now() - start);
+}
+
+// Matrix times column vector, recorded as a product with N = 1.
+template <class VT, class MT1, typename T>
+void Prod(VT&& Out, const MT1& A, const blaze::DynamicVector<T, blaze::columnVector>& b,
+          const char* site) {
+  if(!GemmProfile::Enabled()) {
+    Out = A * b;
+    return;
+  }
+  GemmProfile::Clock::time_point start = GemmProfile::Clock::now();
+  Out = A * b;
+  GemmProfile::Add(site, A.rows(), 1, A.columns(),
+                   GemmProfile::Clock::now() - start);
+}
+
+// Row i of a row-padded matrix, which starts on a SIMD boundary, so the
+// compiler vectorizes loops over it with aligned loads and stores.
+template <class MT>
+float* AlignedRow(MT& m, size_t i) {
+  return static_cast<float*>(__builtin_assume_aligned(m.data() + i * m.spacing(),
+                                                      blaze::AlignmentOf<float>::value));
+}
+
+template <class MT>
+const float* AlignedRow(const MT& m, size_t i) {
+  return static_cast<const float*>(__builtin_assume_aligned(m.data() + i * m.spacing(),
+                                                            blaze::AlignmentOf<float>::value));
+}
+
+// Out = A * trans(B) with the rows of B at ids, or all of them if ids is
+// empty. B has a row per output, e.g. per target word of an output layer,
+// and the rows of a shortlist are read where they are.
+void IndexedProd(Matrix& Out, const Matrix& A, const Matrix& B,
+                 const std::vector<size_t>& ids);
+
+inline void IndexedProd(Matrix& Out, const Matrix& A, const Matrix& B,
+                        const std::vector<size_t>& ids, const char* site) {
+  if(!GemmProfile::Enabled()) {
+    IndexedProd(Out, A, B, ids);
+    return;
+  }
+  GemmProfile::Clock::time_point start = GemmProfile::Clock::now();
+  IndexedProd(Out, A, B, ids);
+  GemmProfile::Add(site, A.rows(), Out.columns(), A.columns(),
+                   GemmProfile::Clock::now() - start);
+}
+
 template <class MT>
 void Softmax(MT& Out) {
-  size_t rows = Out.rows();
-  size_t cols = Out.columns();
-  float sum[rows];
-  for (int j = 0; j < rows; ++j) {
-    sum[j] = 0;
-    for (int i = 0; i < cols; ++i) {
-      Out(j, i) = expapprox(Out(j, i));
-      sum[j] += Out(j, i);
-    }
-    for(int i = 0; i < cols; ++i) {
-      Out(j, i) /= sum[j];
-    }
+  const Kernels& kernels = Kernels::Get();
+  for (size_t j = 0; j < Out.rows(); ++j) {
+    kernels.softmax(AlignedRow(Out, j), Out.columns());
   }
 }
 
@@ -0,0 +1,23 @@
+#include "cpu/mblas/packed_matrix.h"
+
+#include "common/exception.h"
+#include "cpu/mblas/kernels.h"
+
+namespace CPU {
+
+namespace mblas {
+
+const size_t PackedMatrix::PanelWidth;
+
+void PackedProd(Matrix& Out, const Matrix& A, const PackedMatrix& B) {
+  UTIL_THROW_IF2(A.columns() != B.rows(),
+                 "Cannot multiply " << A.rows() << "x" << A.columns()
+                 << " by " << B.rows() << "x" << B.columns());
+
+  Out.resize(A.rows(), B.columns(), false);
+  Kernels::Get().packedProd(Out.data(), Out.spacing(), A.data(), A.spacing(), A.rows(), B);
+}
+
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <algorithm>
+#include <ostream>
+#include <vector>
+
+#include "cpu/mblas/matrix.h"
+
+namespace CPU {
+
+namespace mblas {
+
+// A weight matrix B [K x N] repacked for products A * B with few rows in A,
+// the beam size in the decoder. The columns are cut into panels of
+// PanelWidth columns, every panel is stored as K consecutive rows of
+// PanelWidth floats, and the last panel is padded with zeros. A product
+// then streams through B exactly once, in order, while the rows of the
+// result for one panel stay in registers.
+class PackedMatrix {
+  public:
+    static const size_t PanelWidth = 16;
+
+    PackedMatrix()
+    : rows_(0), columns_(0) {}
+
+    template <class MT>
+    explicit PackedMatrix(const MT& B)
+    : rows_(B.rows()), columns_(B.columns()),
+      data_(Panels() * rows_ * PanelWidth, 0.0f)
+    {
+      Pack([&B](size_t k, size_t j) { return B(k, j); });
+    }
+
+    float operator()(size_t k, size_t j) const {
+      return Panel(j / PanelWidth)[k * PanelWidth + j % PanelWidth];
+    }
+
+    size_t rows() const {
+      return rows_;
+    }
+
+    size_t columns() const {
+      return columns_;
+    }
+
+    size_t Panels() const {
+      return (columns_ + PanelWidth - 1) / PanelWidth;
+    }
+
+    const float* Panel(size_t p) const {
+      return data_.data() + p * rows_ * PanelWidth;
+    }
+
+    // For Bytes() and AdviseHugePages().
+    const float* data() const {
+      return data_.data();
+    }
+
+    size_t capacity() const {
+      return data_.capacity();
+    }
+
+  private:
+    template <class Get>
+    void Pack(Get get) {
+      for(size_t p = 0; p < Panels(); ++p) {
+        float* panel = data_.data() + p * rows_ * PanelWidth;
+        size_t cols = std::min(PanelWidth, columns_ - p * PanelWidth);
+        for(size_t k = 0; k < rows_; ++k)
+          for(size_t j = 0; j < cols; ++j)
+            panel[k * PanelWidth + j] = get(k, p * PanelWidth + j);
+      }
+    }
+
+    size_t rows_;
+    size_t columns_;
+    std::vector<float> data_;
+};
+
+inline std::ostream& operator<<(std::ostream& out, const PackedMatrix& B) {
+  for(size_t k = 0; k < B.rows(); ++k) {
+    for(size_t j = 0; j < B.columns(); ++j)
+      out << " " << B(k, j);
+    out << "\n";
+  }
+  return out;
+}
+
+// Out = A * B with a register blocked kernel for every row count up to a
+// block size, A is cut into blocks of that many rows.
+void PackedProd(Matrix& Out, const Matrix& A, const PackedMatrix& B);
+
+inline void Prod(Matrix& Out, const Matrix& A, const PackedMatrix& B,
+                 const char* site) {
+  if(!GemmProfile::Enabled()) {
+    PackedProd(Out, A, B);
+    return;
+  }
+  GemmProfile::Clock::time_point start = GemmProfile::Clock::now();
+  PackedProd(Out, A, B);
+  GemmProfile::Add(site, A.rows(), B.columns(), A.columns(),
+                   GemmProfile::Clock::now() - start);
+}
+
+}
+
+}
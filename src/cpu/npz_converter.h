@@ -1,5 +1,9 @@
 #pragma once
 
+#include <memory>
+#include <thread>
+#include <boost/iostreams/device/mapped_file.hpp>
+
 #include "cnpy/cnpy.h"
 #include "mblas/matrix.h"
 
@@ -45,18 +49,34 @@ class NpzConverter {
       blaze::unpadded, blaze::rowMajor> BlazeWrapper;
         
     
+    // Uncompressed archives are memory-mapped, every matrix is then copied
+    // once, straight from the mapping into its final storage. Other archives
+    // are read into memory, their arrays in parallel.
     NpzConverter(const std::string& file)
-      : model_(cnpy::npz_load(file)),
+      : file_(new boost::iostreams::mapped_file_source(file)),
         destructed_(false) {
+      if(!cnpy::npz_view(file_->data(), file_->size(), model_)) {
+        model_.clear();
+        file_.reset();
+        model_ = cnpy::npz_load(file, std::thread::hardware_concurrency());
       }
+    }
     
+    // Takes ownership of arrays already in memory, e.g. generated weights.
+    NpzConverter(cnpy::npz_t&& model)
+      : model_(std::move(model)),
+        destructed_(false) {
+      }
+
     ~NpzConverter() {
       if(!destructed_)
-        model_.destruct();
+        Destruct();
     }
     
     void Destruct() {
-      model_.destruct();
+      // views of a mapping own nothing
+      if(!file_)
+        model_.destruct();
       destructed_ = true;
     }
     
@@ -79,12 +99,13 @@ class NpzConverter {
       auto it = model_.find(key);
       if(it != model_.end()) {
         NpyMatrixWrapper np(it->second);
-        matrix = BlazeWrapper(np.data(), np.size1(), np.size2());
+        matrix = blaze::trans(BlazeWrapper(np.data(), np.size1(), np.size2()));
       }
-      return blaze::trans(matrix);
+      return matrix;
     }
   
   private:
+    std::unique_ptr<boost::iostreams::mapped_file_source> file_;
     cnpy::npz_t model_;
     bool destructed_;
 };
@@ -71,7 +71,7 @@ class BestHyps {
           const size_t beamSize,
           const std::vector<ScorerPtr>& scorers,
           const Words& filterIndices,
-          bool returnAlignment) {
+          const DecoderOptions& options) {
       using namespace mblas;
 
       mblas::Matrix& Probs = static_cast<mblas::Matrix&>(scorers[0]->GetProbs());
@@ -90,7 +90,7 @@ class BestHyps {
         Element(_1 + weights_[scorers[i]->GetName()] * _2, Probs, currProbs);
       }
 
-      if (!God::Get<bool>("allow-unk")) {
+      if (!options.allowUnk) {
         DisAllowUNK(Probs);
       }
 
@@ -100,7 +100,7 @@ class BestHyps {
       FindBests(beamSize, Probs, bestCosts, bestKeys);
 
       std::vector<HostVector<float>> breakDowns;
-      bool doBreakdown = God::Get<bool>("n-best");
+      bool doBreakdown = options.nBest;
       if (doBreakdown) {
           breakDowns.push_back(bestCosts);
           for (size_t i = 1; i < scorers.size(); ++i) {
@@ -112,11 +112,9 @@ class BestHyps {
           }
       }
 
-      bool filter = God::Get<std::vector<std::string>>("softmax-filter").size();
-
       for (size_t i = 0; i < beamSize; i++) {
         size_t wordIndex = bestKeys[i] % Probs.Cols();
-        if (filter) {
+        if (options.softmaxFilter) {
           wordIndex = filterIndices[wordIndex];
         }
 
@@ -124,7 +122,7 @@ class BestHyps {
         float cost = bestCosts[i];
 
         HypothesisPtr hyp;
-        if (returnAlignment) {
+        if (options.returnAlignment) {
           hyp.reset(new Hypothesis(prevHyps[hypIndex], wordIndex, hypIndex, cost,
                                    GetAlignments(scorers, hypIndex)));
         } else {
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <thread>
+
 #include "cnpy/cnpy.h"
 #include "mblas/matrix_functions.h"
 
@@ -40,8 +42,9 @@ class NpzConverter {
     };
 
   public:
+    // The arrays are read in parallel.
     NpzConverter(const std::string& file)
-      : model_(cnpy::npz_load(file)),
+      : model_(cnpy::npz_load(file, std::thread::hardware_concurrency())),
         destructed_(false) {
       }
 
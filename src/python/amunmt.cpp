@@ -1,8 +1,8 @@
 #include <cstdlib>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <boost/timer/timer.hpp>
-#include <boost/thread/tss.hpp>
 #include <boost/python.hpp>
 
 #include "common/god.h"
@@ -11,35 +11,17 @@
 #include "common/search.h"
 #include "common/printer.h"
 #include "common/sentence.h"
+#include "common/translation_task.h"
 #include "common/exception.h"
 
-History TranslationTask(const std::string& in, size_t taskCounter) {
-  #ifdef __APPLE__
-    static boost::thread_specific_ptr<Search> s_search;
-    Search *search = s_search.get();
-
-    if(search == NULL) {
-      LOG(info) << "Created Search for thread " << std::this_thread::get_id();
-      search = new Search(taskCounter);
-      s_search.reset(search);
-    }
-  #else
-    thread_local std::unique_ptr<Search> search;
-
-    if(!search) {
-      LOG(info) << "Created Search for thread " << std::this_thread::get_id();
-      search.reset(new Search(taskCounter));
-    }
-  #endif
-
-  return search->Decode(Sentence(taskCounter, in));
-}
+// Created by init() and reused by every translate() call, so the workers
+// set up their scorers and warm up once.
+std::unique_ptr<ThreadPool> pool;
 
 void init(const std::string& options) {
+  pool.reset();
   God::Init(options);
-}
 
-boost::python::list translate(boost::python::list& in) {
   size_t cpuThreads = God::Get<size_t>("cpu-threads");
   LOG(info) << "Setting CPU thread count to " << cpuThreads;
 
@@ -54,15 +36,28 @@ boost::python::list translate(boost::python::list& in) {
   LOG(info) << "Total number of threads: " << totalThreads;
   UTIL_THROW_IF2(totalThreads == 0, "Total number of threads is 0");
 
-  ThreadPool pool(totalThreads);
+  pool.reset(new ThreadPool(totalThreads, TranslationWorkerInit()));
+
+  // the workers' searches must go before the scorers God holds
+  static bool registered = false;
+  if(!registered) {
+    std::atexit([] { pool.reset(); });
+    registered = true;
+  }
+}
+
+boost::python::list translate(boost::python::list& in) {
+  UTIL_THROW_IF2(!pool, "Call init() before translate()");
+  DecoderOptionsPtr options = God::GetDecoderOptions();
   std::vector<std::future<History>> results;
 
   boost::python::list output;
   for(int i = 0; i < boost::python::len(in); ++i) {
     std::string s = boost::python::extract<std::string>(boost::python::object(in[i]));
+    SentencePtr sentence(new Sentence(i, s));
     results.emplace_back(
-        pool.enqueue(
-            [=]{ return TranslationTask(s, i); }
+        pool->enqueue(
+            [=]{ return TranslationTask(sentence, *options); }
         )
     );
   }
@@ -71,7 +66,7 @@ boost::python::list translate(boost::python::list& in) {
 
   for (auto&& result : results) {
     std::stringstream ss;
-    Printer(result.get(), lineCounter++, ss);
+    Printer(result.get(), lineCounter++, ss, *options);
     output.append(ss.str());
   }
 